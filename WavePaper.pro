@@ -1,10 +1,13 @@
-QT       += core gui
+QT       += core gui concurrent
 #QT += charts
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++11
 
+# zlib compresses the streamed PNG exports (see PngStreamWriter)
+LIBS += -lz
+
 # The following define makes your compiler emit warnings if you use
 # any Qt feature that has been marked deprecated (the exact warnings
 # depend on your compiler). Please consult the documentation of the
@@ -17,21 +20,35 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    bufferpool.cpp \
     colourmap.cpp \
+    fasttrig.cpp \
+    fourbar.cpp \
+    framequeue.cpp \
+    framescheduler.cpp \
     imagegen.cpp \
     interact.cpp \
     main.cpp \
     mainwindow.cpp \
+    pngstreamwriter.cpp \
     previewscene.cpp \
+    strokeraster.cpp \
     valueEditors.cpp
 
 HEADERS += \
+    bufferpool.h \
     colourmap.h \
     datatypes.h \
+    fasttrig.h \
+    fourbar.h \
+    framequeue.h \
+    framescheduler.h \
     imagegen.h \
     interact.h \
     mainwindow.h \
+    pngstreamwriter.h \
     previewscene.h \
+    strokeraster.h \
     valueEditors.h
 
 FORMS += \
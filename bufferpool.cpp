@@ -0,0 +1,261 @@
+#include "bufferpool.h"
+#include <QMutexLocker>
+#include <QtConcurrent>
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/** ****************************************************************************
+ * @brief BufferPool::Instance
+ * @return the pool shared by all arrays. It's never destroyed, as arrays held
+ * by other static objects may be released after it would be.
+ */
+BufferPool& BufferPool::Instance() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+BufferPool::BufferPool() {
+    spillDir = qgetenv("WAVEPAPER_SPILL_DIR");
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::SizeClass
+ * @param bytes
+ * @return the size of the buffer that's used to hold the given number of bytes
+ */
+size_t BufferPool::SizeClass(size_t bytes) {
+    if (bytes <= minClassBytes) {
+        return minClassBytes;
+    }
+    size_t hi = minClassBytes;
+    while (hi < bytes) {
+        hi <<= 1;
+    }
+    size_t lo = hi >> 1;
+    size_t step = lo >> 2;
+    return lo + (bytes - lo + step - 1) / step * step;
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::Acquire provides a buffer, reusing a free one if possible
+ * @param bytes is the minimum size
+ * @param zeroed is optional. Set true if the buffer is a fresh mapping, which
+ * the kernel has filled with zeros, otherwise false
+ * @return an aligned buffer of at least bytes. Its contents are undefined,
+ * unless zeroed. Must be handed back with Release, with the same number of bytes.
+ */
+void* BufferPool::Acquire(size_t bytes, bool* zeroed) {
+    size_t classBytes = SizeClass(bytes);
+    if (zeroed) {
+        *zeroed = false;
+    }
+    {
+        QMutexLocker lock(&mutex);
+        auto it = freeLists.find(classBytes);
+        if (it != freeLists.end() && !it->isEmpty()) {
+            void* ptr = it->takeLast();
+            cachedBytes -= classBytes;
+            return ptr;
+        }
+    }
+    return Allocate(classBytes, zeroed);
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::Release hands a buffer back to the pool. It's kept for
+ * reuse, unless the pool already holds too much, or it's file backed (so that
+ * the spill file is removed as soon as the export that needed it is done).
+ * @param ptr was provided by Acquire. nullptr is ignored
+ * @param bytes is the size that was passed to Acquire
+ */
+void BufferPool::Release(void* ptr, size_t bytes) {
+    if (!ptr) {
+        return;
+    }
+    size_t classBytes = SizeClass(bytes);
+    {
+        QMutexLocker lock(&mutex);
+        bool spilled = mappedBuffers.value(ptr, false);
+        if (!spilled && cachedBytes + classBytes <= maxCachedBytes) {
+            freeLists[classBytes].append(ptr);
+            cachedBytes += classBytes;
+            return;
+        }
+    }
+    Deallocate(ptr, classBytes);
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::Trim returns all free buffers to the system
+ */
+void BufferPool::Trim() {
+    QHash<size_t, QVector<void*>> lists;
+    {
+        QMutexLocker lock(&mutex);
+        lists.swap(freeLists);
+        cachedBytes = 0;
+    }
+    for (auto it = lists.begin(); it != lists.end(); ++it) {
+        for (void* ptr : it.value()) {
+            Deallocate(ptr, it.key());
+        }
+    }
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::CachedBytes
+ * @return the total size of the free buffers held for reuse
+ */
+size_t BufferPool::CachedBytes() const {
+    QMutexLocker lock(&mutex);
+    return cachedBytes;
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::Allocate gets a new buffer from the system. Large buffers
+ * are mapped (file backed if they're very large, and a spill directory is set).
+ * Small buffers, and large buffers that can't be mapped, are allocated.
+ * @param classBytes is a size class
+ * @param zeroed is optional. Set true if the buffer was mapped (so is all zeros)
+ * @return the buffer
+ */
+void* BufferPool::Allocate(size_t classBytes, bool* zeroed) {
+    void* ptr = nullptr;
+    bool spilled = false;
+    if (classBytes >= spillMinBytes && !spillDir.isEmpty()) {
+        ptr = MapSpillFile(classBytes);
+        spilled = (ptr != nullptr);
+    }
+    if (!ptr && classBytes >= mapMinBytes) {
+        ptr = MapAnonymous(classBytes);
+    }
+    if (ptr) {
+        QMutexLocker lock(&mutex);
+        mappedBuffers.insert(ptr, spilled);
+        if (zeroed) {
+            *zeroed = true;
+        }
+        return ptr;
+    }
+
+    ptr = qMallocAligned(classBytes, alignment);
+    if (!ptr) {
+        qFatal("BufferPool::Allocate: failed to allocate %llu bytes", (unsigned long long)classBytes);
+    }
+    return ptr;
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::Deallocate returns a buffer to the system
+ * @param ptr was provided by Allocate
+ * @param classBytes is the size class that it was allocated with
+ */
+void BufferPool::Deallocate(void* ptr, size_t classBytes) {
+    bool mapped = false;
+    {
+        QMutexLocker lock(&mutex);
+        mapped = (mappedBuffers.remove(ptr) > 0);
+    }
+    if (!mapped) {
+        qFreeAligned(ptr);
+        return;
+    }
+#ifdef Q_OS_LINUX
+    munmap(ptr, classBytes);
+#endif
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::MapAnonymous maps a large buffer of memory. It's aligned
+ * to a huge page, and marked for transparent huge pages, which reduces TLB
+ * misses & page faults. The pages are touched by several threads, so that the
+ * page faults (and zeroing by the kernel) happen in parallel.
+ * @param classBytes is a size class of at least mapMinBytes
+ * @return the buffer. nullptr if mapping isn't available or failed
+ */
+void* BufferPool::MapAnonymous(size_t classBytes) {
+#ifdef Q_OS_LINUX
+    // Over-map, then unmap the ends, to get huge page alignment
+    size_t mapBytes = classBytes + hugePageBytes;
+    void* map = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        qWarning("BufferPool::MapAnonymous: failed to map %llu bytes", (unsigned long long)mapBytes);
+        return nullptr;
+    }
+    char* start = static_cast<char*>(map);
+    char* aligned = reinterpret_cast<char*>((reinterpret_cast<quintptr>(start) + hugePageBytes - 1) & ~(quintptr)(hugePageBytes - 1));
+    if (aligned > start) {
+        munmap(start, aligned - start);
+    }
+    size_t tailBytes = (start + mapBytes) - (aligned + classBytes);
+    if (tailBytes > 0) {
+        munmap(aligned + classBytes, tailBytes);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, classBytes, MADV_HUGEPAGE);
+#endif
+    FirstTouch(aligned, classBytes);
+    return aligned;
+#else
+    Q_UNUSED(classBytes)
+    return nullptr;
+#endif
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::MapSpillFile maps a buffer to a new file in spillDir. The
+ * file is deleted immediately, so is removed once the buffer is unmapped (or
+ * the program exits). The kernel writes pages to the file when RAM is short.
+ * @param classBytes is a size class
+ * @return the buffer. nullptr if the file couldn't be created or mapped
+ */
+void* BufferPool::MapSpillFile(size_t classBytes) {
+#ifdef Q_OS_LINUX
+    QByteArray path = spillDir + "/wavepaper-spill-XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) {
+        qWarning("BufferPool::MapSpillFile: failed to create a file in %s", spillDir.constData());
+        return nullptr;
+    }
+    unlink(path.constData());
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)classBytes) == 0) {
+        map = mmap(nullptr, classBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        qWarning("BufferPool::MapSpillFile: failed to map %llu bytes to %s",
+                 (unsigned long long)classBytes, path.constData());
+        return nullptr;
+    }
+    qDebug("BufferPool: spilled %llu MB to %s", (unsigned long long)(classBytes >> 20), spillDir.constData());
+    return map;
+#else
+    Q_UNUSED(classBytes)
+    return nullptr;
+#endif
+}
+
+/** ****************************************************************************
+ * @brief BufferPool::FirstTouch writes to every page of a new buffer, in
+ * parallel. Each thread faults in a chunk of hugePageBytes at a time.
+ * @param ptr
+ * @param bytes
+ */
+void BufferPool::FirstTouch(void* ptr, size_t bytes) {
+    QVector<size_t> chunks;
+    for (size_t offset = 0; offset < bytes; offset += hugePageBytes) {
+        chunks.append(offset);
+    }
+    char* base = static_cast<char*>(ptr);
+    const size_t pageBytes = 4096; // The smallest page size
+    QtConcurrent::blockingMap(chunks, [base, bytes, pageBytes](const size_t& offset) {
+        size_t end = qMin(offset + hugePageBytes, bytes);
+        for (size_t i = offset; i < end; i += pageBytes) {
+            base[i] = 0;
+        }
+    });
+}
@@ -0,0 +1,60 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+
+/** ****************************************************************************
+ * @brief The BufferPool class provides the large, aligned buffers for the 2D
+ * arrays (Array2D_C). Released buffers are kept in free lists by size class,
+ * and handed out again, so that rendering frames of a steady size doesn't
+ * allocate (or page fault) once the pool is warm.
+ * Sizes are rounded up to a size class. There are 4 classes per power of 2, so
+ * at most 25% of a buffer is unused.
+ * On Linux, large buffers are mapped directly, aligned for transparent huge
+ * pages, and first touched by several threads. If the environment variable
+ * WAVEPAPER_SPILL_DIR is set, the largest buffers are backed by (deleted)
+ * files in that directory instead, so that huge exports can exceed the RAM.
+ * Thread safe.
+ */
+class BufferPool
+{
+public:
+    static constexpr size_t alignment = 64; // Buffers are aligned to cache lines [bytes]
+    static constexpr size_t minClassBytes = 4096; // The smallest size class [bytes]
+    static constexpr size_t maxCachedBytesDflt = (size_t)512 << 20; // Free buffers beyond this are returned to the system [bytes]
+    static constexpr size_t mapMinBytes = (size_t)32 << 20; // Buffers of at least this size are mapped directly (Linux) [bytes]
+    static constexpr size_t spillMinBytes = (size_t)256 << 20; // Buffers of at least this size are file backed, if a spill directory is set [bytes]
+    static constexpr size_t hugePageBytes = (size_t)2 << 20; // Mapped buffers are aligned to this, and first touched in chunks of this [bytes]
+
+    static BufferPool& Instance();
+
+    void* Acquire(size_t bytes, bool* zeroed = nullptr);
+    void Release(void* ptr, size_t bytes);
+    void Trim();
+
+    size_t CachedBytes() const;
+    static size_t SizeClass(size_t bytes);
+
+private:
+    BufferPool();
+    Q_DISABLE_COPY(BufferPool)
+
+    void* Allocate(size_t classBytes, bool* zeroed);
+    void Deallocate(void* ptr, size_t classBytes);
+    void* MapAnonymous(size_t classBytes);
+    void* MapSpillFile(size_t classBytes);
+    static void FirstTouch(void* ptr, size_t bytes);
+
+    mutable QMutex mutex; // Protects everything below
+    QHash<size_t, QVector<void*>> freeLists; // Free buffers, by size class
+    size_t cachedBytes = 0; // Total size of the free buffers
+    size_t maxCachedBytes = maxCachedBytesDflt;
+    QHash<void*, bool> mappedBuffers; // Buffers that were mapped rather than allocated. True if file backed
+    QByteArray spillDir; // Directory for file backed buffers. Empty for none
+};
+
+#endif // BUFFERPOOL_H
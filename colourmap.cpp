@@ -33,6 +33,7 @@ void ColourMap::EditColourLoc(ColourList& colourList, qint32 listIdx, qreal newL
 void ColourMap::SetColourList(ColourList &clrListIn) {
     emit PreColourListReset();
     clrList = clrListIn;
+    ClrListChanged();
     emit PostColourListReset();
 }
 
@@ -92,6 +93,7 @@ void ColourMap::SetPreset(ClrMapPreset preset)
         clrList.append(ClrFix(QColor(255,0,0), 6./6.));
         break;
     }
+    ClrListChanged();
     emit PostColourListReset();
     imgGen.NewImageNeeded();
 }
@@ -187,6 +189,20 @@ inline qreal ColourMap::GetMaskValue(const GenSettings& genSet, qreal loc) const
     return fa * genSet.maskIndexed[idxBefore] + fb * genSet.maskIndexed[idxBefore + 1];
 }
 
+/** ****************************************************************************
+ * @brief ColourMap::ClrListChanged invalidates everything drawn with the colour list
+ */
+void ColourMap::ClrListChanged() {
+    imgGen.InvalidateField(&clrList);
+}
+
+/** ****************************************************************************
+ * @brief ColourMap::MaskSettingChanged invalidates everything drawn with the mask
+ */
+void ColourMap::MaskSettingChanged() {
+    imgGen.InvalidateField(&maskCfg);
+}
+
 /** ****************************************************************************
  * @brief ColourMap::GetClrFix
  * @param index
@@ -422,6 +438,7 @@ bool ClrListTableModel::setData(const QModelIndex &index, const QVariant &value,
         if (!checkIndex(index)) { return false; }
         if (index.column() == colLoc && index.row() < clrList.length()) {
             clrList[index.row()].loc = value.toReal();
+            imgGen.InvalidateField(&clrList);
             emit dataChanged(index, index);
             imgGen.NewImageNeeded();
             return true;
@@ -481,6 +498,7 @@ void ClrListTableModel::TableClicked(const QModelIndex &index)
         QRgb clrRgbNew = clrNew.rgb();
         if (index.row() < clrList.length()) {
             clrList[index.row()].clr = clrRgbNew;
+            imgGen.InvalidateField(&clrList);
             imgGen.NewPreviewImageNeeded();
         }
         emit dataChanged(index, index);
@@ -506,6 +524,7 @@ bool ClrListTableModel::removeRows(int startRow, int rowCount, const QModelIndex
         }
     }
     endRemoveRows();
+    imgGen.InvalidateField(&clrList);
     imgGen.NewPreviewImageNeeded();
     return true;
 }
@@ -521,6 +540,7 @@ bool ClrListTableModel::insertRows(int startRow, int rowCount, const QModelIndex
         clrList.insert(startRow, ClrFix(Qt::white, 1.0));
     }
     endInsertRows();
+    imgGen.InvalidateField(&clrList);
     imgGen.NewPreviewImageNeeded();
     return true;
 }
@@ -549,6 +569,7 @@ bool ClrListTableModel::moveRows(const QModelIndex &sourceParent, int sourceRow,
         }
     }
     endMoveRows();
+    imgGen.InvalidateField(&clrList);
     imgGen.NewPreviewImageNeeded();
     return true;
 }
@@ -715,13 +736,16 @@ void ColourMapEditorWidget::DrawColourBars(GenSettings & genSet, qint32 sumClrBa
         }
     }
 
-    imgBarBase = QImage((uchar*)dataBarBase->getDataPtr(), barWidth, sizeClrBar.height(), QImage::Format_ARGB32,
+    imgBarBase = QImage((uchar*)dataBarBase->getDataPtr(), barWidth, sizeClrBar.height(),
+                        dataBarBase->stride * (int)sizeof(QRgb), QImage::Format_ARGB32,
                        ImageDataDealloc, dataBarBase);
 
-    imgBarMask = QImage((uchar*)dataBarMask->getDataPtr(), barWidth, sizeClrBar.height(), QImage::Format_ARGB32,
+    imgBarMask = QImage((uchar*)dataBarMask->getDataPtr(), barWidth, sizeClrBar.height(),
+                        dataBarMask->stride * (int)sizeof(QRgb), QImage::Format_ARGB32,
                        ImageDataDealloc, dataBarMask);
 
-    imgBarResult = QImage((uchar*)dataBarResult->getDataPtr(), barWidth, sizeClrBar.height(), QImage::Format_ARGB32,
+    imgBarResult = QImage((uchar*)dataBarResult->getDataPtr(), barWidth, sizeClrBar.height(),
+                        dataBarResult->stride * (int)sizeof(QRgb), QImage::Format_ARGB32,
                        ImageDataDealloc, dataBarResult);
 
     lblClrBarBase.setPixmap(QPixmap::fromImage(imgBarBase));
@@ -818,7 +842,7 @@ void ColourMapEditorWidget::resizeEvent(QResizeEvent *event)
 {
     QWidget::resizeEvent(event);
     if (lblClrBarBase.width() != barWidth) {
-        DrawColourBars(imgGen.genPreview, 1234);
+        DrawColourBars(imgGen.genPreview, sumClrBars);
     }
 }
 
@@ -8,7 +8,14 @@
 #include <QDebug>
 #include <QColor>
 #include <QPainterPath>
+#include <QImage>
 #include <complex>
+#include <cmath>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "bufferpool.h"
 
 #define FP_TO_INT(fp) (fp + 0.5 - (fp<0))
 #define PI (3.14159265359)
@@ -23,9 +30,56 @@ enum class ProgramMode {
     fourBar,
 };
 
+/** ****************************************************************************
+ * @brief The Array2DView_C class is a non-owning view of a rectangle of a 2D
+ * array (see Array2D_C). Views are cheap to copy. A view can be restricted to a
+ * sub-rectangle, or have its origin moved, without changing the array or any
+ * other view of it, so each thread can work through its own views.
+ * T is const for a read-only view.
+ */
+template <typename T>
+class Array2DView_C {
+private:
+    T* dataZero = nullptr; // Pointer that corresponds to the index [0,0]. It may not be a valid address
+public:
+    int32_t xLeft = 0;
+    int32_t yTop = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    ptrdiff_t stride = 0; // Elements from the start of one row to the next
+
+public:
+    Array2DView_C() {}
+    Array2DView_C(T* dataZero_, int32_t xLeft_, int32_t yTop_, int32_t width_, int32_t height_, ptrdiff_t stride_) :
+        dataZero(dataZero_), xLeft(xLeft_), yTop(yTop_), width(width_), height(height_), stride(stride_) {}
+    operator Array2DView_C<const T>() const {
+        return Array2DView_C<const T>(dataZero, xLeft, yTop, width, height, stride);
+    }
+
+    /// The view with its origin moved, such that point (x, y) of the result is point (x - d.x, y - d.y) of this
+    Array2DView_C translated(QPoint d) const {
+        return Array2DView_C(dataZero - d.y() * stride - d.x(), xLeft + d.x(), yTop + d.y(), width, height, stride);
+    }
+    /// The view restricted to area, which must be within rect()
+    Array2DView_C sub(QRect area) const {
+        return Array2DView_C(dataZero, area.left(), area.top(), area.width(), area.height(), stride);
+    }
+
+    inline T* row(int32_t y) const {return dataZero + y * stride;} // Index the result by x
+    inline T& getPoint(int32_t x, int32_t y) const {return dataZero[x + y * stride];}
+    inline T& getPoint(QPoint p) const {return getPoint(p.x(), p.y());}
+    QRect rect() const {return QRect(xLeft, yTop, width, height);}
+};
+
 /** ****************************************************************************
  * @brief The Map2D_C class
  * A 2D array of a data type
+ * The data is held in a buffer from the BufferPool (64 byte aligned, and reused
+ * once the array is deleted). Rows are padded so that each starts on a 64 byte
+ * boundary. Elements of types with a constructor (such as complex, which starts
+ * at 0) are constructed. Other types are uninitialised.
+ * Arrays can be moved, but not copied. Use views (view() & constView()) to
+ * work on part of an array, or with a moved origin.
  */
 template <typename T>
 class Array2D_C {
@@ -34,57 +88,105 @@ private:
     T* data = nullptr;
     T* dataZero = nullptr; // Pointer that corresponds to the index [0,0]. It may not be a valid address
 public:
-    int32_t xLeft; // Usually negative
-    int32_t yTop; // Usually negative
-    const int32_t width;
-    const int32_t height;
+    // Read only
+    int32_t xLeft = 0; // Usually negative
+    int32_t yTop = 0; // Usually negative
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0; // Elements from the start of one row to the next. width + padding
 
 public:
     explicit Array2D_C(int32_t xLeft_, int32_t yTop_, int32_t width_, int32_t height_) :
         xLeft(xLeft_), yTop(yTop_),
-        width(width_), height(height_) {
-        data = new T[width * height];
-        dataZero = &data[-yTop * width - xLeft];
+        width(width_), height(height_), stride(PaddedStride(width_)) {
+        bool zeroed = false;
+        data = static_cast<T*>(BufferPool::Instance().Acquire(byteCount(), &zeroed));
+        // Fresh mappings are already zeros, which is T() for the trivially
+        // copyable element types (complex), so they're left as they are rather
+        // than rewriting every page that FirstTouch has just faulted in
+        bool isValueInit = zeroed && std::is_trivially_copyable<T>::value;
+        if (!std::is_trivially_default_constructible<T>::value && !isValueInit) {
+            for (T* p = data; p < data + (size_t)stride * height; p++) {
+                new (p) T();
+            }
+        }
+        dataZero = &data[-(ptrdiff_t)yTop * stride - xLeft];
     }
     explicit Array2D_C(QPoint topLeft, QSize sz) :
         Array2D_C(topLeft.x(), topLeft.y(), sz.width(), sz.height()) {}
     explicit Array2D_C(QRect rect) :
         Array2D_C(rect.topLeft(), rect.size()) {}
-
-    ~Array2D_C() {
-        if (data != nullptr) {
-            delete data;
+    Array2D_C(const Array2D_C&) = delete;
+    Array2D_C& operator=(const Array2D_C&) = delete;
+    Array2D_C(Array2D_C&& other) {
+        *this = std::move(other);
+    }
+    Array2D_C& operator=(Array2D_C&& other) {
+        if (this != &other) {
+            Free();
+            data = other.data;
+            dataZero = other.dataZero;
+            xLeft = other.xLeft;
+            yTop = other.yTop;
+            width = other.width;
+            height = other.height;
+            stride = other.stride;
+            other.data = nullptr;
+            other.dataZero = nullptr;
+            other.width = other.height = other.stride = 0;
         }
+        return *this;
     }
 
-    T* getDataPtr() const {return data;}
+    ~Array2D_C() {
+        Free();
+    }
 
-    void translate(int32_t deltaX, int32_t deltaY) {
-        xLeft += deltaX;
-        yTop += deltaY;
-        dataZero = &dataZero[-deltaY * width - deltaX];
+    /// The row length, padded such that every row starts on an aligned boundary
+    static int32_t PaddedStride(int32_t width) {
+        const size_t align = BufferPool::alignment;
+        size_t rowBytes = (sizeof(T) * (size_t)width + align - 1) / align * align;
+        return rowBytes % sizeof(T) == 0 ? (int32_t)(rowBytes / sizeof(T)) : width;
     }
-    inline void translate(QPoint p) {translate(p.x(), p.y());}
+    size_t byteCount() const {return sizeof(T) * (size_t)stride * height;}
+
+    T* getDataPtr() const {return data;}
+    Array2DView_C<T> view() const {return Array2DView_C<T>(dataZero, xLeft, yTop, width, height, stride);}
+    Array2DView_C<const T> constView() const {return view();}
 
+    inline T* row(int32_t y) const {return dataZero + (ptrdiff_t)y * stride;} // Index the result by x
     inline T& getPoint(int32_t x, int32_t y) const {
-        return dataZero[x + y * width];
+        return dataZero[x + (ptrdiff_t)y * stride];
     }
     inline void setPoint(int32_t x, int32_t y, const T& val) const {
-        dataZero[x +  + y * width] = val;
+        dataZero[x + (ptrdiff_t)y * stride] = val;
     }
     inline void addPoint(int32_t x, int32_t y, const T& val) const {
-        dataZero[x +  + y * width] += val;
+        dataZero[x + (ptrdiff_t)y * stride] += val;
     }
     inline T& getPoint(QPoint p) const {
-        return dataZero[p.x() + p.y() * width];
+        return getPoint(p.x(), p.y());
     }
     inline void setPoint(QPoint p, const T& val) const {
-        dataZero[p.x() + p.y() * width] = val;
+        setPoint(p.x(), p.y(), val);
     }
     inline void addPoint(QPoint p, const T& val) const {
-        dataZero[p.x() + p.y() * width] += val;
+        addPoint(p.x(), p.y(), val);
     }
     QRect rect() const {return QRect(xLeft, yTop, width, height);}
+
+private:
+    void Free() {
+        if (data != nullptr) {
+            if (!std::is_trivially_destructible<T>::value) {
+                for (T* p = data; p < data + (size_t)stride * height; p++) {
+                    p->~T();
+                }
+            }
+            BufferPool::Instance().Release(data, byteCount());
+            data = nullptr;
+        }
+    }
 };
 
 typedef qreal fpComplex; // Float or double
@@ -92,6 +194,24 @@ typedef std::complex<fpComplex> complex;
 typedef Array2D_C<complex> Complex2D_C;
 typedef Array2D_C<double> Double2D_C;
 typedef Array2D_C<QRgb> Rgb2D_C;
+typedef Array2DView_C<complex> Complex2DView_C;
+typedef Array2DView_C<const complex> Complex2DConstView_C;
+typedef Array2DView_C<const double> Double2DConstView_C;
+
+/** ****************************************************************************
+ * @brief The PackedPhasor struct is one point of a phasor template. It holds
+ * the distance from the emitter (fixed point) and the amplitude, rather than
+ * the phasor itself. It's half the size of a complex, and doesn't depend on
+ * the wavelength. The phase is found with a multiply & a table lookup (see
+ * ImageGen::AddPhasorArr).
+ */
+struct PackedPhasor {
+    static constexpr double distPerPix = 256.; // Distance units per image pixel
+    quint32 dist; // Distance from the emitter [1/256 image pixels]
+    float amp; // Amplitude
+};
+typedef Array2D_C<PackedPhasor> Packed2D_C;
+typedef Array2DView_C<const PackedPhasor> Packed2DConstView_C;
 
 /** ************************************************************************ **/
 /// Emitters
@@ -126,7 +246,7 @@ struct EmArrangement {
 
 struct EmitterF { // Emitter, floating point coords
     QPointF loc; // Simulation coordinates
-    double distOffset; // determines the phase. default 0. NOT SUPPORTED (for efficiency)!
+    double distOffset; // determines the phase (a phase lag of distOffset / wavelength revolutions). default 0. Simulation units
     double amplitude; // default of 1
     EmitterF() : loc(0,0), distOffset(0), amplitude(1) {}
     EmitterF(QPointF p) : loc(p), distOffset(0), amplitude(1) {}
@@ -137,7 +257,7 @@ struct EmitterF { // Emitter, floating point coords
 
 struct EmitterI { // Emitter, integer coords
     QPoint loc; // Image coordinates (integers)
-    double distOffset; // determines the phase. NOT SUPPORTED!
+    double distOffset; // determines the phase. Simulation units
     double amplitude; // default of 1
     EmitterI() : loc(0,0), distOffset(0), amplitude(1) {}
     EmitterI(QPoint p) : loc(p), distOffset(0), amplitude(1) {}
@@ -189,48 +309,29 @@ qreal Snap(qreal val, qreal snapInc);
 qint32 Snap(qint32 val, qint32 snapInc, qint32 snapWithin);
 
 /** ****************************************************************************
- * @brief The CheckSum class performs a very simple sum over data
- * ranges, treating all data as arrays of uint8_t. Used to compare data.
+ * @brief The Stage enum lists the stages of the render pipeline. Each stage has
+ * a version that is bumped whenever a setting it depends on is edited (see
+ * ImageGen::Invalidate), so cached data is rebuilt only when it's out of date.
  */
-class CheckSum {
-public:
-    qint32 sum = 0;
-    CheckSum() {}
-    CheckSum(void* ptr, int byteCount) {
-        Add(ptr, byteCount);
-    }
-    inline void Add(quint8 val) {
-        sum += val;
-    }
-    void Add(void* ptr, int byteCount) {
-        quint8 * ptr8 = (quint8 *) ptr;
-        quint8 * ptrEnd = ptr8 + byteCount;
-        while (ptr8 < ptrEnd) {
-            Add(*ptr8++);
-        }
-    }
-    void Add(qint8 val) {
-        return Add((quint8)val);
-    }
-    void Add(qint16 val) {
-        return Add((void *) &val, sizeof(val));
-    }
-    void Add(quint16 val) {
-        return Add((void *) &val, sizeof(val));
-    }
-    void Add(qint32 val) {
-        return Add((void *) &val, sizeof(val));
-    }
-    void Add(quint32 val) {
-        return Add((void *) &val, sizeof(val));
-    }
-    qint32 Get() {return sum;}
-    bool operator ==(CheckSum b) {return sum == b.sum;}
-    bool operator !=(CheckSum b) {return sum != b.sum;}
-    operator int() const {return sum;}
+enum class Stage {
+    emitters, // Emitter locations, from the arrangements
+    templates, // Distance, amplitude & phasor templates
+    sum, // Phasor sum of all emitters
+    normalise, // Displayed value of the sum (see FieldMode), with its min & max
+    colourLut, // Colour & mask indices
+    colouring, // Colour map applied to the image
+    fourBarGeom, // Four bar path & its raster
+    count
 };
 
-
+/** ****************************************************************************
+ * @brief The StageVersions struct holds one version per pipeline stage
+ */
+struct StageVersions {
+    quint64 v[(int)Stage::count] = {}; // 0 is never a valid version
+    quint64& operator[](Stage stage) {return v[(int)stage];}
+    quint64 operator[](Stage stage) const {return v[(int)stage];}
+};
 
 /** ************************************************************************ **/
 struct TemplateDist {
@@ -243,47 +344,156 @@ struct TemplateAmp {
 };
 struct TemplatePhasor {
     // Use the MakeNew function to make any changes to these variables (ensures that variables are in sync)
-    Complex2D_C * arr = nullptr; // Simulation units. Depends on imgPerSimUnit or wavelength.
-    qreal wavelength; // The wavelength that this template was generated with
+    Packed2D_C * arr = nullptr; // Index is image units. Depends on imgPerSimUnit & the amplitude template (not the wavelength)
     qreal imgPerSimUnit; // The imgPerSimUnit that this template was generated with
-    void MakeNew(QRect size, qreal wavelengthIn, qreal imgPerSimUnitIn);
+    qreal distOffset; // The distOffset of the amplitude template that this template was generated from
+    void MakeNew(QRect size, qreal imgPerSimUnitIn, qreal distOffsetIn);
+};
+/** ****************************************************************************
+ * @brief The FieldMode enum selects the value of the phasor sum that's
+ * displayed (see ImageGen::CalcFieldValues)
+ */
+enum class FieldMode {
+    amplitude, // |P|
+    real, // Re(P * e^(i*theta)), where theta is the animation time phase. The range is +-max|P|
+    phase, // arg(P * e^(i*theta)). The range is +-pi. Suits a cyclic colour map
+    intensity, // |P|^2. No square root is needed
+    count
 };
+
 struct SumArray {
     Complex2D_C * phasorArr = nullptr; // Resultant phasor of all emitters summed together
-    Double2D_C * ampArr = nullptr; // Amplitude of each point in sumArr
+    Double2D_C * ampArr = nullptr; // Displayed value (see FieldMode) of each point in sumArr
     double ampMax = 0;
     double ampMin = 999999;
-    qint32 checkSum = 0;
+    qint64 CacheBytes() const;
+    void Release();
+};
+
+/** ****************************************************************************
+ * @brief The FourBarCfg struct holds all of the settings that define the four
+ * bar linkage
+ */
+struct FourBarCfg {
+    qreal baseSepX = 0.6; // Horizontal separation of the 2 bases are, as a factor of lenBase. 0+
+    qreal baseOffsetY = 0.; // Vertical offset of the 2 bases, as a factor of lenBase; -ve to +ve
+
+    qreal lenRatioB = 1.0; // Length of Arm B = Length of Arm A * lenRatioB;
+    qreal lenRatio2 = 4.0; // Length of Segment 2 = Length of Segment 1 * lenRatio2;
+    qreal lenBase = 30;
+
+    qreal ta1Init = 0; // Initial angle of a1 [rad]
+    qreal initAngleOffset = 0; // initAngleB = initAngleA + initAngleOffset [rad]
+    qreal revCount = 20; // When to stop drawing, in number of revolutions (A + B combined)
+
+    qreal revRatioB = 1.02; // The rate of increasing the angle of 'B' vs 'A'
+
+    qreal lineWidth = 1.0;
+    qreal lineTaperRatio = 0.8;
+    bool densityMode = false; // If false, draw the path as lines. If true, accumulate path density, coloured by the colour map
+    qreal temp = 0.01; // !@#
+
+    /// True if every setting that affects the shape of the path, except revCount, matches
+    bool SameGeometryExceptRevCount(const FourBarCfg& o) const {
+        return baseSepX == o.baseSepX && baseOffsetY == o.baseOffsetY
+                && lenRatioB == o.lenRatioB && lenRatio2 == o.lenRatio2
+                && ta1Init == o.ta1Init && initAngleOffset == o.initAngleOffset
+                && revRatioB == o.revRatioB;
+    }
+    /// True if every setting except revCount matches (so a drawing with the shorter revCount is part of the other)
+    bool SameExceptRevCount(const FourBarCfg& o) const {
+        return baseSepX == o.baseSepX && baseOffsetY == o.baseOffsetY
+                && lenRatioB == o.lenRatioB && lenRatio2 == o.lenRatio2 && lenBase == o.lenBase
+                && ta1Init == o.ta1Init && initAngleOffset == o.initAngleOffset
+                && revRatioB == o.revRatioB
+                && lineWidth == o.lineWidth && lineTaperRatio == o.lineTaperRatio;
+    }
+};
+
+/** ****************************************************************************
+ * @brief The FourBarPath struct holds the points of a four bar linkage path
+ * as structure-of-arrays. Linkage units (see FourBar). NaN for points with no solution.
+ */
+struct FourBarPath {
+    QVector<double> t; // Step of each point. Whole numbers, unless the path is adaptive
+    QVector<double> x;
+    QVector<double> y;
+    qint32 Count() const {return x.size();}
+    double Span(qint32 i) const {return t[i] - t[i - 1];} // Steps covered by the segment ending at point i
+    qint32 PointsUpTo(double step) const { // The number of points at or before step
+        return std::upper_bound(t.constBegin(), t.constEnd(), step) - t.constBegin();
+    }
+    bool IsValid(qint32 i) const {return !std::isnan(x[i]) && !std::isnan(y[i]);}
+};
+
+/** ****************************************************************************
+ * @brief The FourBarDensity struct holds the buffers of a density (long
+ * exposure) image. They're kept between frames, so are only reallocated when
+ * the image grows. See FourBar::SplatDensity
+ */
+struct FourBarDensity {
+    QVector<float> density; // One value per pixel, row by row
+    QVector<QVector<qint32>> bandSegments; // The segments that touch each band of rows
+    qint64 CacheBytes() const {
+        qint64 bytes = (qint64)density.capacity() * sizeof(float);
+        for (const QVector<qint32>& segments : bandSegments) {
+            bytes += (qint64)segments.capacity() * sizeof(qint32);
+        }
+        return bytes;
+    }
 };
 
 /** ****************************************************************************
  * @brief The GenSettings struct
+ * It owns its cached arrays, so can't be copied
  */
 struct GenSettings {
+    GenSettings() {}
+    GenSettings(const GenSettings&) = delete;
+    GenSettings& operator=(const GenSettings&) = delete;
+    ~GenSettings() {ReleaseCaches();}
+
     static constexpr qint32 dfltImgPointsQuick = 200000; // Target pixels in the image. May be less than this.
     static constexpr qint32 dfltImgPointsPreview = 500000; // Target pixels in the image. May be less than this.
     double targetImgPoints = dfltImgPointsPreview; // Total number of points in the preview. Change with setTargetImgPoints()
-    double imgPerSimUnit; // The imgPerSimUnit that this template was generated with
+    double imgPerSimUnit = 0; // The imgPerSimUnit that this template was generated with
     QRect areaImg; // The rectangle of the image view area (image coordinates)
     bool indexedClr = true; // True for faster (but less accurate) colour map
+    qreal chordTolerance = 0.2; // Four bar: max distance between the curve and the drawn segments [pixels]. 0 for fixed steps
     // Cached data
+    StageVersions builtVersion; // The stage versions that the cached data was built from
+    QVector<EmitterI> emittersImg; // Emitter locations in image coordinates
     TemplateDist templateDist;
     TemplateAmp templateAmp;
     TemplatePhasor templatePhasor;
     SumArray combinedArr;
+    static constexpr qint32 spectralCount = 3; // Spectral mode: the number of wavelengths (red, green, blue)
+    SumArray spectralArr[spectralCount]; // Spectral mode: the sum for each wavelength. combinedArr isn't used
+    // Memory use. See ImageGen::EnsureMemory
+    quint64 lastUsed = 0; // The render count when these settings were last used. The least recently used caches are evicted first
+    bool templateOversize = true; // False when memory is short: templates are made just big enough
+    bool usePhasorTemplate = true; // False when memory is short: phasors are calculated from the distance & amplitude templates
+    qint64 CacheBytes() const;
+    void ReleaseCaches();
     // Colour index
     int clrIndexMax = 200; // The colour indices span from 0 to this number
     // Colour map
-    qint32 clrListCheckSum = 0; // The checksum for the colour list when the index was generated
     QVector<QColor> clrIndexed; // All colours from locations 0 to 1.0 (indices 0 to clrIndexMax)
     QVector<QRgb> clrIndexedRgb; // All colours from locations 0 to 1.0 (indices 0 to clrIndexMax)
     // Mask map
-    qint32 maskCheckSum = 0; // The checksum for the mask when the index was generated
     QVector<qreal> maskIndexed; // All mask values from locations 0 to 1.0 (indices 0 to clrIndexMax). Values are 0 to 1.0.
     QVector<quint32> maskIndexedInt; // All mask values from locations 0 to 1.0 (indices 0 to clrIndexMax). Values are (0 to 255) << 24
 
+    // Timing of the last image generated with these settings
+    qint64 lastFrameMs = 0; // Total generation time
+    qint64 lastOneOffMs = 0; // Time spent rebuilding cached data (templates, colour index) that won't recur every frame
+
     // Four bar linkage
-    QPainterPath paintPath;
+    QImage fourBarRaster; // The path drawn so far. Extended in place when only revCount grows
+    FourBarCfg fourBarRasterCfg; // The settings that fourBarRaster was drawn with
+    quint64 fourBarRasterGeomSerial = 0; // The serial of the geometry that fourBarRaster was drawn from
+    qint32 fourBarRasterSteps = 0; // The number of path steps drawn into fourBarRaster
+    FourBarDensity fourBarDensity; // Density mode buffers
     qreal pointsPerRev; // Setting. How many points in the path per revolution of A & B. Low = polygonal. High = quality curves. 100 is low quality. 200 = high quality.
 };
 
@@ -335,30 +545,6 @@ struct MaskCfg { // Mask settings
 };
 
 
-/** ****************************************************************************
- * @brief The FourBarCfg struct holds all of the settings that define the four
- * bar linkage
- */
-struct FourBarCfg {
-    qreal baseSepX = 0.6; // Horizontal separation of the 2 bases are, as a factor of lenBase. 0+
-    qreal baseOffsetY = 0.; // Vertical offset of the 2 bases, as a factor of lenBase; -ve to +ve
-
-    qreal lenRatioB = 1.0; // Length of Arm B = Length of Arm A * lenRatioB;
-    qreal lenRatio2 = 4.0; // Length of Segment 2 = Length of Segment 1 * lenRatio2;
-    qreal lenBase = 30;
-
-    qreal ta1Init = 0; // Initial angle of a1 [rad]
-    qreal initAngleOffset = 0; // initAngleB = initAngleA + initAngleOffset [rad]
-    qreal revCount = 20; // When to stop drawing, in number of revolutions (A + B combined)
-
-    qreal revRatioB = 1.02; // The rate of increasing the angle of 'B' vs 'A'
-
-    qreal lineWidth = 1.0;
-    qreal lineTaperRatio = 0.8;
-    qreal temp = 0.01; // !@#
-};
-
-
 /** ****************************************************************************
  * @brief The Settings struct holds all of the settings that describe the
  * current pattern
@@ -367,8 +553,11 @@ struct Settings {
     double wavelength = 20; // Wavelength. Simulation units
     double distOffsetF = 0.1; // controls linearity. Range 0 to 1+, normally 0.1. Amplitude drops off at rate of 1/(r + sceneLength * distOffsetF).
     // as distOffsetF approaches 0, the amplitude at each emitter approaches infinity.
-    bool emittersInSync; // If true then all emitters are in phase with the same amplitude. If false, then the energizer determines phase & amplitude
-    QPointF energizerLoc; // The location of the energizer that determines amplitude and phase by the distance to each emitter
+    bool emittersInSync = true; // If true then all emitters are in phase with the same amplitude. If false, then the energizer determines phase & amplitude
+    QPointF energizerLoc = QPointF(0, 0); // The location of the energizer that determines amplitude and phase by the distance to each emitter. Simulation units
+    double energizerDistOffsetF = 1.; // Emitter amplitude drops off at a rate of 1/(r + meanR * energizerDistOffsetF), where r is the distance from the energizer
+    FieldMode fieldMode = FieldMode::amplitude; // The value of the field that's displayed
+    bool spectralMode = false; // If false, one wavelength, coloured by the colour map. If true, red, green & blue wavelengths, mapped to those channels. wavelength is the green wavelength
     QList<EmArrangement> emArrangements;
     ColourList clrList; // Editing this should be handled through the ColourMap class, to update the table accordingly
     MaskCfg maskCfg;
@@ -0,0 +1,49 @@
+#include "fasttrig.h"
+#include <cmath>
+
+FastTrig::Entry FastTrig::table[FastTrig::tableLen];
+
+/** ****************************************************************************
+ * @brief FastTrig::Init calculates the sin table
+ */
+void FastTrig::Init() {
+    const double radPerIdx = 2. * PI / tableLen;
+    for (quint32 i = 0; i < tableLen; i++) {
+        double sinThis = sin(i * radPerIdx);
+        double sinNext = sin((i + 1) * radPerIdx);
+        table[i].sin = sinThis;
+        table[i].sinDelta = (sinNext - sinThis) / (double)(1u << fracBits);
+    }
+}
+
+/** ****************************************************************************
+ * @brief FastTrig::SinCosArr calculates sin & cos for an array of phases
+ * @param phases
+ * @param sinOut
+ * @param cosOut
+ * @param count is the number of elements in each array
+ */
+void FastTrig::SinCosArr(const Phase *phases, double *sinOut, double *cosOut, qint32 count) {
+    for (qint32 i = 0; i < count; i++) {
+        sinOut[i] = Sin(phases[i]);
+        cosOut[i] = Sin(phases[i] + quarterTurn);
+    }
+}
+
+/** ****************************************************************************
+ * @brief FastTrig::PolarArr calculates an array of phasors from arrays of
+ * amplitude and distance. out[i] = amp[i] * e^(j * dist[i] * phasePerDist)
+ * @param amp
+ * @param dist
+ * @param phasePerDist is the phase (2^32 per revolution) per unit of distance.
+ * May be negative.
+ * @param out
+ * @param count is the number of elements in each array
+ */
+void FastTrig::PolarArr(const double *amp, const double *dist, double phasePerDist,
+                        complex *out, qint32 count) {
+    for (qint32 i = 0; i < count; i++) {
+        Phase phase = (Phase)(qint64)(dist[i] * phasePerDist);
+        out[i] = complex(amp[i] * Sin(phase + quarterTurn), amp[i] * Sin(phase));
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef FASTTRIG_H
+#define FASTTRIG_H
+
+#include <QtGlobal>
+#include "datatypes.h"
+
+/** ****************************************************************************
+ * @brief The FastTrig class is the table based sin & cos used by all of the
+ * image generation engines.
+ * Angles are fixed point phases: one revolution is 2^32, so phases wrap around
+ * with unsigned overflow (no modulus operation is required). The table length
+ * is a power of 2, so the table index is just the top bits of the phase. The
+ * remaining bits linearly interpolate between table entries.
+ * With tableBits = 12, the maximum error is ~3e-7.
+ * Init() must be called before use.
+ */
+class FastTrig {
+public:
+    typedef quint32 Phase; // Fixed point angle. 2^32 = 1 revolution
+
+    static constexpr int tableBits = 12; // Table length is 2^tableBits. Increase for more accuracy
+    static constexpr quint32 tableLen = 1u << tableBits;
+    static constexpr double phasePerTurn = 4294967296.; // 2^32
+    static constexpr double phasePerRad = phasePerTurn / (2. * PI);
+
+    static void Init();
+
+    /// Convert from radians to a fixed point phase. Valid for |rad| < ~1e10
+    static inline Phase RadToPhase(double rad) {
+        return (Phase)(qint64)(rad * phasePerRad);
+    }
+    /// Convert from revolutions to a fixed point phase. Valid for |turns| < ~2e9
+    static inline Phase TurnsToPhase(double turns) {
+        return (Phase)(qint64)(turns * phasePerTurn);
+    }
+
+    static inline double Sin(Phase phase) {
+        const Entry& e = table[phase >> fracBits];
+        return e.sin + (double)(phase & fracMask) * e.sinDelta;
+    }
+    static inline double Cos(Phase phase) {
+        return Sin(phase + quarterTurn);
+    }
+    static inline void SinCos(Phase phase, double& sinOut, double& cosOut) {
+        sinOut = Sin(phase);
+        cosOut = Sin(phase + quarterTurn);
+    }
+    static inline void SinCosRad(double rad, double& sinOut, double& cosOut) {
+        SinCos(RadToPhase(rad), sinOut, cosOut);
+    }
+
+    // Batch entry points. These loops are written to be auto-vectorised
+    static void SinCosArr(const Phase* phases, double* sinOut, double* cosOut, qint32 count);
+    static void PolarArr(const double* amp, const double* dist, double phasePerDist,
+                         complex* out, qint32 count);
+
+private:
+    static constexpr int fracBits = 32 - tableBits;
+    static constexpr Phase fracMask = (1u << fracBits) - 1;
+    static constexpr Phase quarterTurn = 1u << 30;
+
+    struct Entry {
+        double sin; // sin at the start of this entry
+        double sinDelta; // Change in sin per phase unit, up to the next entry
+    };
+    static Entry table[tableLen];
+};
+
+#endif // FASTTRIG_H
@@ -0,0 +1,670 @@
+#include "fourbar.h"
+#include <QtConcurrent>
+#include <QLineF>
+#include <QVector>
+#include <cmath>
+#include <algorithm>
+
+static_assert(FourBar::adaptiveBatchIntervals < FourBar::batchLen,
+              "The coarse points of an adaptive batch must fit in one CalcBatch call");
+
+/** ****************************************************************************
+ * @brief FourBar::MakeLinkage calculates the linkage dimensions
+ * @param fb
+ * @return the linkage, in linkage units
+ */
+FourBar::Linkage FourBar::MakeLinkage(const FourBarCfg &fb) {
+    Linkage lk;
+    lk.xa = -fb.baseSepX;
+    lk.xb = fb.baseSepX;
+    lk.ya = -2 + fb.baseOffsetY;
+    lk.yb = -2 - fb.baseOffsetY;
+
+    lk.la1 = 1.;
+    lk.lb1 = fb.lenRatioB;
+    lk.la2 = fb.lenRatio2;
+    lk.lb2 = fb.lenRatioB * fb.lenRatio2;
+    return lk;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::MakeTransform
+ * @param fb
+ * @param imgSize is the size of the image that the path will be drawn on
+ * @return the mapping from linkage units to image coordinates
+ */
+FourBar::PathTransform FourBar::MakeTransform(const FourBarCfg &fb, QSize imgSize) {
+    qreal imgCoordScaler = 0.001 * (imgSize.width() + imgSize.height()); // Scales according to the output size
+    PathTransform tf;
+    tf.scale = imgCoordScaler * fb.lenBase;
+    tf.dx = imgSize.width()/2;
+    tf.dy = imgSize.height()*0.6;
+    return tf;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::MakeStrokeStyle calculates the line widths for an image
+ * @param fb
+ * @param imgSize is the size of the image that the path will be drawn on
+ * @param pointsPerRev
+ * @return
+ */
+FourBar::StrokeStyle FourBar::MakeStrokeStyle(const FourBarCfg &fb, QSize imgSize, qreal pointsPerRev) {
+    qreal imgCoordScaler = 0.001 * (imgSize.width() + imgSize.height()); // Scales according to the output size
+    StrokeStyle style;
+    style.widthVariable = fb.lineWidth * imgCoordScaler * fb.lineTaperRatio;
+    style.widthFixed = fb.lineWidth * imgCoordScaler * (1.0 - fb.lineTaperRatio);
+    style.pointsPerRev = pointsPerRev;
+    return style;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::GeometryTolerance converts a chord tolerance in pixels to
+ * linkage units. The result is rounded down to a power of 2, so that small
+ * changes in scale (e.g. resizing the view) don't require a new path.
+ * @param chordTolerancePix. 0 for a point at every step
+ * @param scale is the image pixels per linkage unit
+ * @return
+ */
+qreal FourBar::GeometryTolerance(qreal chordTolerancePix, qreal scale) {
+    if (!(chordTolerancePix > 0) || !(scale > 0)) {
+        return 0;
+    }
+    return exp2(floor(log2(chordTolerancePix / scale)));
+}
+
+/** ****************************************************************************
+ * @brief FourBar::UpdateGeometry brings a cached path up to date. The path is
+ * kept if only revCount changed to a value that needs no more steps, extended
+ * if more steps are needed, and recalculated otherwise.
+ * @param fb
+ * @param pointsPerRev
+ * @param tolerance is the chord tolerance [linkage units]. 0 for a point at every step
+ * @param stepCount
+ * @param geo is the cache
+ * @return true if the path was changed in any way
+ */
+bool FourBar::UpdateGeometry(const FourBarCfg &fb, qreal pointsPerRev, qreal tolerance,
+                             qint32 stepCount, Geometry &geo) {
+    bool sameShape = geo.cfg.SameGeometryExceptRevCount(fb)
+            && geo.pointsPerRev == pointsPerRev && geo.tolerance == tolerance;
+    if (sameShape && stepCount <= geo.stepCount) {
+        return false; // Any extra steps are simply not drawn
+    }
+    qint32 stepFirst = sameShape ? geo.stepCount : 0;
+    Linkage lk = MakeLinkage(fb);
+    if (CalcPath(fb, lk, pointsPerRev, tolerance, stepFirst, stepCount, geo.path) == 0) {
+        geo.serial++;
+    }
+    geo.cfg = fb;
+    geo.pointsPerRev = pointsPerRev;
+    geo.tolerance = tolerance;
+    geo.stepCount = stepCount;
+    return true;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::PeriodRevs finds the number of revolutions after which the
+ * path repeats itself.
+ * Per revolution, A turns 1/(1+r) and B turns r/(1+r), where r = revRatioB.
+ * If r = p/q (in lowest terms), both cranks are back at their initial angles
+ * after p+q revolutions, and the path closes. p/q is found with continued
+ * fractions, accepting the first convergent whose error would cause less than
+ * periodTolerance of drift over the period.
+ * @param fb
+ * @return the period in revolutions, or 0 if the path doesn't repeat (within
+ * the denominator limit)
+ */
+qreal FourBar::PeriodRevs(const FourBarCfg &fb) {
+    const double r = fb.revRatioB;
+    if (!(r >= 0) || r > maxPeriodDenominator) {
+        return 0; // Also keeps floor(r) & the convergents well within qint64
+    }
+    // Convergents h/k of the continued fraction of r
+    qint64 hPrev = 1, h = (qint64)floor(r);
+    qint64 kPrev = 0, k = 1;
+    double x = r;
+    for (int i = 0; i < 64; i++) {
+        double period = (double)(h + k);
+        if (fabs(r - (double)h / k) * 2. * PI * period < periodTolerance) {
+            return period;
+        }
+        double frac = x - floor(x);
+        if (frac < 1e-15) {
+            break;
+        }
+        x = 1. / frac;
+        qint64 a = (qint64)floor(x);
+        if (a > (maxPeriodDenominator - kPrev) / k) {
+            break; // kNext would be over the limit. a can be ~1e15, so check before multiplying
+        }
+        qint64 hNext = a * h + hPrev;
+        qint64 kNext = a * k + kPrev;
+        hPrev = h; h = hNext;
+        kPrev = k; k = kNext;
+    }
+    return 0;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::StepCount calculates how many steps to draw: revCount worth
+ * of steps, but no more than one complete period of the path (any more would
+ * just retrace the same curve)
+ * @param fb
+ * @param pointsPerRev
+ * @return
+ */
+qint32 FourBar::StepCount(const FourBarCfg &fb, qreal pointsPerRev) {
+    qint32 stepCount = fb.revCount * pointsPerRev;
+    qreal periodRevs = PeriodRevs(fb);
+    if (periodRevs > 0) {
+        // +1 so that the last segment closes the loop
+        qreal periodSteps = ceil(periodRevs * pointsPerRev) + 1;
+        if (periodSteps < stepCount) {
+            stepCount = (qint32)periodSteps;
+        }
+    }
+    return stepCount;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::CalcPath calculates the points of the path
+ * @param fb
+ * @param lk is the linkage, from MakeLinkage
+ * @param pointsPerRev is the number of steps per revolution (A & B combined)
+ * @param chordTolerance is the max distance between the curve and its segments
+ * [pixels]. 0 for a point at every step.
+ * @param stepFirst extends an existing path, rather than starting from 0.
+ * pathOut must have been calculated with the same settings, up to step
+ * stepFirst-1 or beyond (it is truncated there). If not, or if stepFirst is 0,
+ * the whole path is calculated.
+ * @param stepCount is the total number of steps in the path
+ * @param pathOut receives the points. Points with no solution are NaN.
+ * @return the number of points kept from the existing path (new points start at
+ * this index)
+ */
+qint32 FourBar::CalcPath(const FourBarCfg &fb, const Linkage &lk, qreal pointsPerRev,
+                         qreal chordTolerance, qint32 stepFirst, qint32 stepCount,
+                         FourBarPath &pathOut) {
+    stepCount = qMax(0, stepCount);
+    stepFirst = qBound(0, stepFirst, stepCount);
+
+    // Keep the points up to stepFirst-1, if the existing path reaches it exactly
+    qint32 keepCount = 0;
+    if (stepFirst > 0) {
+        const double tLast = stepFirst - 1;
+        keepCount = std::upper_bound(pathOut.t.constBegin(), pathOut.t.constEnd(), tLast) - pathOut.t.constBegin();
+        if (keepCount == 0 || pathOut.t[keepCount - 1] != tLast) {
+            keepCount = 0;
+            stepFirst = 0;
+        }
+    }
+    pathOut.t.resize(keepCount);
+    pathOut.x.resize(keepCount);
+    pathOut.y.resize(keepCount);
+
+    Stepping st = MakeStepping(fb, pointsPerRev);
+    if (chordTolerance > 0) {
+        CalcAdaptive(lk, st, chordTolerance, stepFirst, stepCount, pathOut);
+    }
+    else {
+        CalcUniform(lk, st, stepFirst, stepCount, pathOut);
+    }
+    return keepCount;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::MakeStepping
+ * @param fb
+ * @param pointsPerRev
+ * @return the crank angles & increments per step
+ */
+FourBar::Stepping FourBar::MakeStepping(const FourBarCfg &fb, qreal pointsPerRev) {
+    Stepping st;
+    st.ta1Init = fb.ta1Init;
+    st.tb1Init = fb.ta1Init + fb.initAngleOffset;
+    st.inca = (1. / (1. + fb.revRatioB)) / pointsPerRev * 2. * PI;
+    st.incb = (fb.revRatioB / (1. + fb.revRatioB)) / pointsPerRev * 2. * PI;
+    return st;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::CalcUniform appends a point for every step from stepFirst
+ * to stepCount-1
+ * @param lk
+ * @param st
+ * @param stepFirst
+ * @param stepCount
+ * @param pathOut
+ */
+void FourBar::CalcUniform(const Linkage &lk, const Stepping &st, qint32 stepFirst,
+                          qint32 stepCount, FourBarPath &pathOut) {
+    pathOut.t.resize(stepCount);
+    pathOut.x.resize(stepCount);
+    pathOut.y.resize(stepCount);
+    for (qint32 step = stepFirst; step < stepCount; step++) {
+        pathOut.t[step] = step;
+    }
+
+    double* xData = pathOut.x.data();
+    double* yData = pathOut.y.data();
+
+    // Every batch is seeded from its own step index, so a path can be extended from any step
+    if (stepCount - stepFirst < minParallelSteps) {
+        for (qint32 start = stepFirst; start < stepCount; start += batchLen) {
+            CalcBatch(lk, st, start, qMin((qint32)batchLen, stepCount - start), xData + start, yData + start);
+        }
+        return;
+    }
+
+    QVector<qint32> batchStarts;
+    batchStarts.reserve((stepCount - stepFirst) / batchLen + 1);
+    for (qint32 start = stepFirst; start < stepCount; start += batchLen) {
+        batchStarts.append(start);
+    }
+    QtConcurrent::blockingMap(batchStarts, [&](const qint32& start) {
+        CalcBatch(lk, st, start, qMin((qint32)batchLen, stepCount - start), xData + start, yData + start);
+    });
+}
+
+/** ****************************************************************************
+ * @brief FourBar::CalcAdaptive appends points from step stepFirst to
+ * stepCount-1, with adaptive spacing.
+ * The coarse grid is every coarseSteps'th step (plus the end points). The
+ * coarse intervals are split into batches, which are subdivided in parallel and
+ * then joined in order. Within a batch, the coarse points are calculated with
+ * CalcBatch (stepping coarseSteps at a time), and only the subdivision
+ * midpoints and end points need CalcPoint.
+ * @param lk
+ * @param st
+ * @param tolerance is the max chord error [pixels]
+ * @param stepFirst is the first step. If it's not 0, pathOut already ends with
+ * its point.
+ * @param stepCount
+ * @param pathOut
+ */
+void FourBar::CalcAdaptive(const Linkage &lk, const Stepping &st, double tolerance,
+                           qint32 stepFirst, qint32 stepCount, FourBarPath &pathOut) {
+    if (stepCount <= 0) {
+        return;
+    }
+    const double tEnd = stepCount - 1;
+    double tStart = stepFirst;
+    if (stepFirst == 0) {
+        double x, y;
+        CalcPoint(lk, st, 0., x, y);
+        pathOut.t.append(0.);
+        pathOut.x.append(x);
+        pathOut.y.append(y);
+    }
+    else {
+        tStart = stepFirst - 1;
+    }
+    if (tStart >= tEnd) {
+        return;
+    }
+
+    // Coarse grid: tStart, then multiples of coarseSteps, then tEnd
+    QVector<double> coarse;
+    coarse.append(tStart);
+    for (double t = (floor(tStart / coarseSteps) + 1) * coarseSteps; t < tEnd; t += coarseSteps) {
+        coarse.append(t);
+    }
+    coarse.append(tEnd);
+
+    const qint32 intervalCount = coarse.size() - 1;
+    const qint32 batchCount = (intervalCount + adaptiveBatchIntervals - 1) / adaptiveBatchIntervals;
+    QVector<PointList> batchPoints(batchCount);
+    PointList* batchData = batchPoints.data(); // Detached once, before the threads start
+    const double toleranceSq = tolerance * tolerance;
+
+    // coarse[i] for 0 < i < intervalCount is (gridFirst + i - 1) * coarseSteps
+    const qint32 gridFirst = (qint32)floor(tStart / coarseSteps) + 1;
+    Stepping stCoarse = st;
+    stCoarse.inca *= coarseSteps;
+    stCoarse.incb *= coarseSteps;
+    auto calcBatch = [&](const qint32& batch) {
+        PointList& out = batchData[batch];
+        const qint32 iFirst = batch * adaptiveBatchIntervals;
+        const qint32 iEnd = qMin(intervalCount, iFirst + adaptiveBatchIntervals);
+
+        // The coarse points iFirst to iEnd (inclusive)
+        double xs[adaptiveBatchIntervals + 1], ys[adaptiveBatchIntervals + 1];
+        const qint32 gridLo = qMax(iFirst, 1);
+        const qint32 gridHi = qMin(iEnd, intervalCount - 1);
+        if (gridHi >= gridLo) {
+            CalcBatch(lk, stCoarse, gridFirst + gridLo - 1, gridHi - gridLo + 1,
+                      xs + (gridLo - iFirst), ys + (gridLo - iFirst));
+        }
+        if (iFirst == 0) {
+            CalcPoint(lk, st, coarse[0], xs[0], ys[0]);
+        }
+        if (iEnd == intervalCount) {
+            CalcPoint(lk, st, coarse[iEnd], xs[iEnd - iFirst], ys[iEnd - iFirst]);
+        }
+
+        for (qint32 i = iFirst; i < iEnd; i++) {
+            Subdivide(lk, st, toleranceSq, coarse[i], xs[i - iFirst], ys[i - iFirst],
+                      coarse[i + 1], xs[i + 1 - iFirst], ys[i + 1 - iFirst], out);
+        }
+    };
+    QVector<qint32> batches;
+    for (qint32 batch = 0; batch < batchCount; batch++) {
+        batches.append(batch);
+    }
+    if (intervalCount * coarseSteps < minParallelSteps) {
+        for (qint32 batch : batches) {
+            calcBatch(batch);
+        }
+    }
+    else {
+        QtConcurrent::blockingMap(batches, calcBatch);
+    }
+
+    for (const PointList& points : batchPoints) {
+        pathOut.t.append(points.t);
+        pathOut.x.append(points.x);
+        pathOut.y.append(points.y);
+    }
+}
+
+/** ****************************************************************************
+ * @brief FourBar::Subdivide appends the points after t0, up to and including t1.
+ * The interval is split at its midpoint if the midpoint is further than the
+ * tolerance from the chord, or if the 2 halves are much longer than the chord
+ * (which catches loops and cusps where the midpoint happens to be near the
+ * chord). Intervals where the linkage stops closing are split down to 1 step,
+ * to match the resolution of a fixed step path.
+ */
+void FourBar::Subdivide(const Linkage &lk, const Stepping &st, double toleranceSq,
+                        double t0, double x0, double y0, double t1, double x1, double y1,
+                        PointList &out) {
+    const double span = t1 - t0;
+    if (span > minAdaptiveSpan) {
+        const bool valid0 = !std::isnan(x0) && !std::isnan(y0);
+        const bool valid1 = !std::isnan(x1) && !std::isnan(y1);
+        if (valid0 || valid1) {
+            const double tm = t0 + span / 2;
+            double xm, ym;
+            CalcPoint(lk, st, tm, xm, ym);
+            const bool validm = !std::isnan(xm) && !std::isnan(ym);
+            bool split;
+            if (valid0 && valid1 && validm) {
+                const double cx = x1 - x0, cy = y1 - y0;
+                const double chordSq = cx*cx + cy*cy;
+                const double mx = xm - x0, my = ym - y0;
+                const double cross = mx*cy - my*cx;
+                // Distance from the midpoint to the chord (or to x0 if the chord has no length)
+                const double errSq = chordSq > 0 ? cross*cross / chordSq : mx*mx + my*my;
+                const double halves = sqrt(mx*mx + my*my) + hypot(x1 - xm, y1 - ym);
+                split = errSq > toleranceSq || halves*halves > 2.25 * chordSq + toleranceSq;
+            }
+            else {
+                split = span > 1.;
+            }
+            if (split) {
+                Subdivide(lk, st, toleranceSq, t0, x0, y0, tm, xm, ym, out);
+                Subdivide(lk, st, toleranceSq, tm, xm, ym, t1, x1, y1, out);
+                return;
+            }
+        }
+    }
+    out.t.append(t1);
+    out.x.append(x1);
+    out.y.append(y1);
+}
+
+/** ****************************************************************************
+ * @brief FourBar::CalcPoint calculates a single point, at any (fractional) step
+ * See CalcBatch for the equations.
+ */
+void FourBar::CalcPoint(const Linkage &lk, const Stepping &st, double t, double &xOut, double &yOut) {
+    const double ta1 = st.ta1Init + t * st.inca;
+    const double tb1 = st.tb1Init + t * st.incb;
+    const double xa2 = lk.xa + lk.la1 * cos(ta1);
+    const double ya2 = lk.ya + lk.la1 * sin(ta1);
+    const double ka = xa2 - lk.xb - lk.lb1 * cos(tb1);
+    const double kb = ya2 - lk.yb - lk.lb1 * sin(tb1);
+    const double la2Sq = lk.la2 * lk.la2;
+    const double kd = 2 * lk.la2 * lk.lb2;
+    const double kc = ka*ka + kb*kb - lk.lb2 * lk.lb2;
+    const double ke = kc - la2Sq;
+    const double n = sqrt(kd*kd - ke*ke) - 2 * lk.la2 * kb;
+    const double d = kc - 2 * lk.la2 * ka + la2Sq;
+    const double invMagSq = 1. / (d*d + n*n);
+    xOut = xa2 + lk.la2 * (d*d - n*n) * invMagSq;
+    yOut = ya2 + lk.la2 * 2 * n * d * invMagSq;
+}
+
+/** ****************************************************************************
+ * @brief FourBar::CalcBatch calculates a batch of up to batchLen points
+ * Equations:
+ * ka = xa - xb + la1*cos(ta1) - lb1*cos(tb1)
+ * kb = ya - yb + la1*sin(ta1) - lb1*sin(tb1)
+ * kc = ka^2 + kb^2 - lb2^2
+ * ta2 = 2*atan2(N, D), where
+ *   N = ((2*la2*lb2)^2 - (kc - la2^2)^2)^(1/2) - 2*la2*kb
+ *   D = kc - 2*la2*ka + la2^2
+ * Only the sin & cos of ta2 are needed. By the double angle formulae:
+ *   cos(ta2) = (D^2 - N^2) / (D^2 + N^2)
+ *   sin(ta2) = 2*N*D / (D^2 + N^2)
+ * When the linkage can't be closed, the square root is NaN, so the point is NaN.
+ * @param lk
+ * @param st
+ * @param stepStart is the step index of the first point in the batch
+ * @param count is the number of points. Max batchLen.
+ * @param xOut
+ * @param yOut
+ */
+void FourBar::CalcBatch(const Linkage &lk, const Stepping &st, qint32 stepStart,
+                        qint32 count, double *xOut, double *yOut) {
+    double ca1[batchLen], sa1[batchLen], cb1[batchLen], sb1[batchLen];
+
+    // Crank angles. Seeded exactly, then advanced by rotation
+    double cosIncA = cos(st.inca), sinIncA = sin(st.inca);
+    double cosIncB = cos(st.incb), sinIncB = sin(st.incb);
+    double ca = cos(st.ta1Init + stepStart * st.inca), sa = sin(st.ta1Init + stepStart * st.inca);
+    double cb = cos(st.tb1Init + stepStart * st.incb), sb = sin(st.tb1Init + stepStart * st.incb);
+    for (qint32 i = 0; i < count; i++) {
+        ca1[i] = ca; sa1[i] = sa;
+        cb1[i] = cb; sb1[i] = sb;
+        double caNext = ca * cosIncA - sa * sinIncA;
+        sa = sa * cosIncA + ca * sinIncA;
+        ca = caNext;
+        double cbNext = cb * cosIncB - sb * sinIncB;
+        sb = sb * cosIncB + cb * sinIncB;
+        cb = cbNext;
+    }
+
+    // Linkage closure. Independent per point, so this loop vectorises
+    const double la2Sq = lk.la2 * lk.la2;
+    const double kd = 2 * lk.la2 * lk.lb2;
+    const double kdSq = kd * kd;
+    const double lb2Sq = lk.lb2 * lk.lb2;
+    for (qint32 i = 0; i < count; i++) {
+        double xa2 = lk.xa + lk.la1 * ca1[i];
+        double ya2 = lk.ya + lk.la1 * sa1[i];
+        double ka = xa2 - lk.xb - lk.lb1 * cb1[i];
+        double kb = ya2 - lk.yb - lk.lb1 * sb1[i];
+        double kc = ka*ka + kb*kb - lb2Sq;
+        double ke = kc - la2Sq;
+        double n = sqrt(kdSq - ke*ke) - 2 * lk.la2 * kb;
+        double d = kc - 2 * lk.la2 * ka + la2Sq;
+        double invMagSq = 1. / (d*d + n*n);
+        xOut[i] = xa2 + lk.la2 * (d*d - n*n) * invMagSq;
+        yOut[i] = ya2 + lk.la2 * 2 * n * d * invMagSq;
+    }
+}
+
+/** ****************************************************************************
+ * @brief FourBar::SplatDensity accumulates the time spent by the path in each
+ * pixel (a "long exposure"). Every segment has a total weight of the number of
+ * steps it covers, spread evenly along it, so slow parts of the path are brighter.
+ * The image is split into bands of densityBandRows rows. The segments are
+ * binned by the bands that they touch, and the bands are splatted in parallel,
+ * each straight into its own rows of the output.
+ * @param path
+ * @param pointCount is the number of points of path to use
+ * @param tf maps the path onto the image
+ * @param imgSize
+ * @param buffers holds the result (one value per pixel, row by row). Its
+ * buffers are reused, so a steady image size doesn't allocate.
+ */
+void FourBar::SplatDensity(const FourBarPath &path, qint32 pointCount, const PathTransform &tf,
+                           QSize imgSize, FourBarDensity &buffers) {
+    const qint32 w = imgSize.width();
+    const qint32 h = imgSize.height();
+    BinDensityBands(path, pointCount, tf, imgSize, densityBandRows, buffers.bandSegments);
+    buffers.density.fill(0.f, w * h);
+
+    float* densityData = buffers.density.data(); // Detached once, before the threads start
+    const QVector<QVector<qint32>>& bandSegments = buffers.bandSegments;
+    QVector<qint32> bands;
+    for (qint32 band = 0; band < bandSegments.size(); band++) {
+        if (!bandSegments[band].isEmpty()) {
+            bands.append(band);
+        }
+    }
+    QtConcurrent::blockingMap(bands, [&](const qint32& band) {
+        const qint32 rowFirst = band * densityBandRows;
+        const qint32 rowEnd = qMin(rowFirst + densityBandRows, h);
+        SplatBand(path, tf, imgSize, bandSegments[band], rowFirst, rowEnd, densityData + (qint64)rowFirst * w);
+    });
+}
+
+/** ****************************************************************************
+ * @brief FourBar::BinDensityBands finds the segments that touch each band of
+ * rows, for SplatBand
+ * @param path
+ * @param pointCount is the number of points of path to use
+ * @param tf
+ * @param imgSize
+ * @param bandRows is the height of each band (the last may be shorter)
+ * @param bandSegments receives one list per band, of the segments (by their
+ * first point) in path order. Existing lists are reused.
+ */
+void FourBar::BinDensityBands(const FourBarPath &path, qint32 pointCount, const PathTransform &tf,
+                              QSize imgSize, qint32 bandRows, QVector<QVector<qint32>> &bandSegments) {
+    const qint32 w = imgSize.width();
+    const qint32 h = imgSize.height();
+    const qint32 bandCount = (h + bandRows - 1) / bandRows;
+    bandSegments.resize(bandCount);
+    for (QVector<qint32>& segments : bandSegments) {
+        segments.resize(0); // Keeps the capacity
+    }
+    const qint32 segCount = qMax(0, qMin(pointCount, path.Count()) - 1);
+    for (qint32 step = 0; step < segCount; step++) {
+        if (!path.IsValid(step) || !path.IsValid(step + 1)) {
+            continue;
+        }
+        // Relative to pixel centres, as in SplatBand. A sample also reaches the next pixel
+        const double x0 = tf.MapX(path.x[step]) - 0.5, x1 = tf.MapX(path.x[step + 1]) - 0.5;
+        const double y0 = tf.MapY(path.y[step]) - 0.5, y1 = tf.MapY(path.y[step + 1]) - 0.5;
+        if (qMax(x0, x1) < -1 || qMin(x0, x1) >= w || qMax(y0, y1) < -1 || qMin(y0, y1) >= h) {
+            continue;
+        }
+        const qint32 rowLo = (qint32)qMax(0., floor(qMin(y0, y1)));
+        const qint32 rowHi = (qint32)qMin(h - 1., floor(qMax(y0, y1)) + 1);
+        for (qint32 band = rowLo / bandRows; band <= rowHi / bandRows; band++) {
+            bandSegments[band].append(step);
+        }
+    }
+}
+
+/** ****************************************************************************
+ * @brief FourBar::SplatBand accumulates segments into the rows rowFirst to
+ * rowEnd - 1. Samples are bilinearly split between the 4 nearest pixels. Only
+ * the samples that reach the band are visited.
+ * @param path
+ * @param tf
+ * @param imgSize
+ * @param segments lists the segments to splat, by their first point
+ * @param rowFirst
+ * @param rowEnd
+ * @param density is the band's buffer: row rowFirst of the image, and the rows
+ * after it
+ */
+void FourBar::SplatBand(const FourBarPath &path, const PathTransform &tf, QSize imgSize,
+                        const QVector<qint32> &segments, qint32 rowFirst, qint32 rowEnd, float *density) {
+    const qint32 w = imgSize.width();
+    for (qint32 step : segments) {
+        const double x0 = tf.MapX(path.x[step]) - 0.5; // Relative to pixel centres
+        const double y0 = tf.MapY(path.y[step]) - 0.5;
+        const double dx = (path.x[step + 1] - path.x[step]) * tf.scale;
+        const double dy = (path.y[step + 1] - path.y[step]) * tf.scale;
+        // At least 1 sample per pixel of length, so that fast sections are continuous
+        const qint32 samples = qBound(1, (qint32)ceil(qMax(fabs(dx), fabs(dy))), 1 << 16);
+        const float weight = path.Span(step + 1) / samples;
+
+        // The samples where floor(sy) is from rowFirst - 1 to rowEnd - 1
+        qint32 iFirst = 0, iEnd = samples;
+        if (dy != 0) {
+            const double ta = (rowFirst - 1 - y0) / dy;
+            const double tb = (rowEnd - y0) / dy;
+            iFirst = (qint32)qBound(0., floor(qMin(ta, tb) * samples - 0.5), (double)samples);
+            iEnd = (qint32)qBound(0., ceil(qMax(ta, tb) * samples - 0.5) + 1, (double)samples);
+        }
+        for (qint32 i = iFirst; i < iEnd; i++) {
+            const double t = (i + 0.5) / samples;
+            const double sx = x0 + dx * t;
+            const double sy = y0 + dy * t;
+            const double fx = floor(sx);
+            const double fy = floor(sy);
+            if (fx < -1 || fy < rowFirst - 1 || fx >= w || fy >= rowEnd) {
+                continue;
+            }
+            const qint32 px = (qint32)fx;
+            const qint32 py = (qint32)fy;
+            const float ax = sx - fx;
+            const float ay = sy - fy;
+            const float wts[4] = {(1 - ax) * (1 - ay) * weight, ax * (1 - ay) * weight,
+                                  (1 - ax) * ay * weight, ax * ay * weight};
+            for (qint32 k = 0; k < 4; k++) {
+                const qint32 qx = px + (k & 1);
+                const qint32 qy = py + (k >> 1);
+                if (qx >= 0 && qx < w && qy >= rowFirst && qy < rowEnd) {
+                    density[(qint64)(qy - rowFirst) * w + qx] += wts[k];
+                }
+            }
+        }
+    }
+}
+
+/** ****************************************************************************
+ * @brief FourBar::DrawSegment draws the segment from point step-1 to step,
+ * unless either point is invalid
+ * @param path
+ * @param tf maps the path onto the target
+ * @param style
+ * @param target
+ * @param step must be 1 or more
+ */
+void FourBar::DrawSegment(const FourBarPath &path, const PathTransform &tf, const StrokeStyle &style,
+                          const RasterTarget &target, qint32 step) {
+    if (!path.IsValid(step - 1) || !path.IsValid(step)) {
+        return; // The linkage can't close here
+    }
+    qreal x0 = tf.MapX(path.x[step - 1]), y0 = tf.MapY(path.y[step - 1]);
+    qreal x1 = tf.MapX(path.x[step]), y1 = tf.MapY(path.y[step]);
+    StrokeRaster::DrawSegment(target, x0, y0, x1, y1, style.Width(hypot(x1 - x0, y1 - y0), path.Span(step)),
+                              qRgb(255, 255, 255));
+}
+
+/** ****************************************************************************
+ * @brief FourBar::SegmentBounds
+ * @param path
+ * @param tf
+ * @param style
+ * @param step must be 1 or more
+ * @return the area that DrawSegment may draw to. Null if it draws nothing.
+ */
+QRectF FourBar::SegmentBounds(const FourBarPath &path, const PathTransform &tf,
+                              const StrokeStyle &style, qint32 step) {
+    if (!path.IsValid(step - 1) || !path.IsValid(step)) {
+        return QRectF();
+    }
+    QPointF p0(tf.MapX(path.x[step - 1]), tf.MapY(path.y[step - 1]));
+    QPointF p1(tf.MapX(path.x[step]), tf.MapY(path.y[step]));
+    qreal reach = style.Width(QLineF(p0, p1).length(), path.Span(step)) / 2 + 1.;
+    return QRectF(p0, p1).normalized().adjusted(-reach, -reach, reach, reach);
+}
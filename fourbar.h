@@ -0,0 +1,124 @@
+#ifndef FOURBAR_H
+#define FOURBAR_H
+
+#include <QtGlobal>
+#include <QSize>
+#include <QRectF>
+#include <QVector>
+#include "datatypes.h"
+#include "strokeraster.h"
+
+/** ****************************************************************************
+ * @brief The FourBar class evaluates the path traced by the four bar linkage.
+ * The geometry is calculated in linkage units (crank A has length 1), so that
+ * it is independent of the image. PathTransform maps it onto an image at
+ * rasterisation time.
+ * The steps are split into batches, which are calculated in parallel. Within a
+ * batch, the crank angles are advanced with a rotation recurrence (no trig
+ * calls), and the recurrence is reseeded exactly at the start of each batch so
+ * that errors can't accumulate over many revolutions.
+ * Alternatively, the path can be adaptive: it starts from a coarse grid of
+ * steps (calculated in batches, as above), and each interval is subdivided until its chord is within a distance
+ * tolerance of the curve. Straight sections then get few points, and tight
+ * curves get many.
+ */
+class FourBar {
+public:
+    static constexpr qint32 batchLen = 512; // Steps per batch. Each batch is a unit of parallel work
+    static constexpr qint32 minParallelSteps = 4 * batchLen; // Paths shorter than this are calculated on the calling thread
+    static constexpr qint64 maxPeriodDenominator = 100000; // Ratios that need a larger denominator are treated as not periodic
+    static constexpr double periodTolerance = 1e-7; // Max crank angle drift over one period [rad], for a ratio to count as periodic
+    static constexpr qint32 coarseSteps = 4; // Adaptive paths start from every coarseSteps'th step
+    static constexpr double minAdaptiveSpan = 1. / 64; // Adaptive intervals aren't subdivided below this many steps
+    static constexpr qint32 adaptiveBatchIntervals = 256; // Coarse intervals per batch. Each batch is a unit of parallel work
+    static constexpr qint32 densityBandRows = 64; // Rows per band of a density image. Each band is a unit of parallel work
+
+    /**
+     * @brief The Linkage struct holds the linkage dimensions, in linkage units
+     */
+    struct Linkage {
+        qreal xa, ya; // Base of arm A
+        qreal xb, yb; // Base of arm B
+        qreal la1, lb1; // Length of the first segments (cranks)
+        qreal la2, lb2; // Length of the second segments
+    };
+
+    /**
+     * @brief The StrokeStyle struct holds the line width settings, in image coordinates
+     */
+    struct StrokeStyle {
+        qreal widthFixed;
+        qreal widthVariable; // Extra width for slow segments
+        qreal pointsPerRev;
+        /// Line width for a segment of length segLen, covering span steps. Fast segments are thinner
+        qreal Width(qreal segLen, qreal span) const {return widthFixed + widthVariable / qMax(1., segLen / span * pointsPerRev * 0.002);}
+    };
+
+    /**
+     * @brief The PathTransform struct maps linkage units to image coordinates
+     */
+    struct PathTransform {
+        qreal scale; // Image pixels per linkage unit
+        qreal dx, dy;
+        qreal MapX(qreal x) const {return x * scale + dx;}
+        qreal MapY(qreal y) const {return y * scale + dy;}
+    };
+
+    /**
+     * @brief The Geometry struct is a cached path, with the settings that it was
+     * calculated with. Only the settings that change the shape of the path are
+     * relevant (not lenBase, line widths or the image size).
+     */
+    struct Geometry {
+        FourBarCfg cfg;
+        qreal pointsPerRev = 0;
+        qreal tolerance = -1; // Chord tolerance [linkage units]
+        qint32 stepCount = 0;
+        quint64 serial = 0; // Incremented when the path is recalculated (but not when it's extended)
+        FourBarPath path; // Linkage units
+    };
+
+    static Linkage MakeLinkage(const FourBarCfg& fb);
+    static PathTransform MakeTransform(const FourBarCfg& fb, QSize imgSize);
+    static StrokeStyle MakeStrokeStyle(const FourBarCfg& fb, QSize imgSize, qreal pointsPerRev);
+    static qreal GeometryTolerance(qreal chordTolerancePix, qreal scale);
+    static bool UpdateGeometry(const FourBarCfg& fb, qreal pointsPerRev, qreal tolerance,
+                               qint32 stepCount, Geometry& geo);
+    static qreal PeriodRevs(const FourBarCfg& fb);
+    static qint32 StepCount(const FourBarCfg& fb, qreal pointsPerRev);
+    static qint32 CalcPath(const FourBarCfg& fb, const Linkage& lk, qreal pointsPerRev,
+                           qreal chordTolerance, qint32 stepFirst, qint32 stepCount,
+                           FourBarPath& pathOut);
+    static void SplatDensity(const FourBarPath& path, qint32 pointCount, const PathTransform& tf,
+                             QSize imgSize, FourBarDensity& buffers);
+    static void BinDensityBands(const FourBarPath& path, qint32 pointCount, const PathTransform& tf,
+                                QSize imgSize, qint32 bandRows, QVector<QVector<qint32>>& bandSegments);
+    static void SplatBand(const FourBarPath& path, const PathTransform& tf, QSize imgSize,
+                          const QVector<qint32>& segments, qint32 rowFirst, qint32 rowEnd, float* density);
+    static void DrawSegment(const FourBarPath& path, const PathTransform& tf, const StrokeStyle& style,
+                            const RasterTarget& target, qint32 step);
+    static QRectF SegmentBounds(const FourBarPath& path, const PathTransform& tf,
+                                const StrokeStyle& style, qint32 step);
+
+private:
+    struct Stepping {
+        double ta1Init, tb1Init; // Crank angles at step 0 [rad]
+        double inca, incb; // Crank angle change per step [rad]
+    };
+    struct PointList {
+        QVector<double> t, x, y;
+    };
+    static Stepping MakeStepping(const FourBarCfg& fb, qreal pointsPerRev);
+    static void CalcUniform(const Linkage& lk, const Stepping& st, qint32 stepFirst,
+                            qint32 stepCount, FourBarPath& pathOut);
+    static void CalcAdaptive(const Linkage& lk, const Stepping& st, double tolerance,
+                             qint32 stepFirst, qint32 stepCount, FourBarPath& pathOut);
+    static void CalcBatch(const Linkage& lk, const Stepping& st, qint32 stepStart,
+                          qint32 count, double* xOut, double* yOut);
+    static void CalcPoint(const Linkage& lk, const Stepping& st, double t, double& xOut, double& yOut);
+    static void Subdivide(const Linkage& lk, const Stepping& st, double toleranceSq,
+                          double t0, double x0, double y0, double t1, double x1, double y1,
+                          PointList& out);
+};
+
+#endif // FOURBAR_H
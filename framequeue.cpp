@@ -0,0 +1,49 @@
+#include "framequeue.h"
+#include <QMutexLocker>
+#include <utility>
+
+/** ****************************************************************************
+ * @brief FrameQueue::BeginRender is called by the renderer to get the buffer
+ * to render into. The buffer's previous image may be reused for its allocation.
+ * @return the in-flight frame
+ */
+Frame& FrameQueue::BeginRender() {
+    QMutexLocker locker(&mutex);
+    return frames[inFlight];
+}
+
+/** ****************************************************************************
+ * @brief FrameQueue::PublishRender is called by the renderer once the
+ * in-flight frame is complete. It becomes the back buffer, and the previous
+ * back buffer becomes the next in-flight buffer.
+ */
+void FrameQueue::PublishRender() {
+    QMutexLocker locker(&mutex);
+    frames[inFlight].serial = ++serialCount;
+    std::swap(inFlight, back);
+    backIsNew = true;
+}
+
+/** ****************************************************************************
+ * @brief FrameQueue::AcquireFront is called by the display to get the most
+ * recent frame. The frame remains valid until the next call to AcquireFront.
+ * @return the front frame, or nullptr if no frame has been published yet
+ */
+const Frame* FrameQueue::AcquireFront() {
+    QMutexLocker locker(&mutex);
+    if (backIsNew) {
+        std::swap(front, back);
+        backIsNew = false;
+        frontValid = true;
+    }
+    return frontValid ? &frames[front] : nullptr;
+}
+
+/** ****************************************************************************
+ * @brief FrameQueue::HasNewFrame
+ * @return true if a frame has been published that hasn't been acquired
+ */
+bool FrameQueue::HasNewFrame() const {
+    QMutexLocker locker(&mutex);
+    return backIsNew;
+}
@@ -0,0 +1,48 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <QImage>
+#include <QColor>
+#include <QMutex>
+
+/** ****************************************************************************
+ * @brief The Frame struct holds one rendered image, plus the information
+ * needed to display it
+ */
+struct Frame {
+    QImage image;
+    qreal imgPerSimUnit = 1; // The imgPerSimUnit that the image was generated with
+    QColor backgroundClr = Qt::black; // Drawn behind the image (visible where the mask is transparent)
+    quint64 serial = 0; // Increments with every published frame
+};
+
+/** ****************************************************************************
+ * @brief The FrameQueue class hands rendered frames from the renderer
+ * (ImageGen) to the display (PreviewView). It holds three buffers:
+ *   front:    owned by the display. The frame currently being displayed.
+ *   back:     the most recently completed frame, waiting to be displayed.
+ *   inFlight: owned by the renderer. The frame currently being rendered.
+ * Buffers are handed over by swapping indices (never by copying), and each
+ * buffer keeps its pixel allocation so that it can be reused by the renderer.
+ * A frame that's replaced before it's displayed is simply recycled.
+ */
+class FrameQueue {
+public:
+    FrameQueue() {}
+    Frame& BeginRender();
+    void PublishRender();
+    const Frame* AcquireFront();
+    bool HasNewFrame() const;
+
+private:
+    mutable QMutex mutex; // Protects the buffer indices
+    Frame frames[3];
+    int front = 0;
+    int back = 1;
+    int inFlight = 2;
+    bool backIsNew = false; // True if the back buffer holds a frame that hasn't been displayed
+    bool frontValid = false; // False until the first frame has been acquired
+    quint64 serialCount = 0;
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,113 @@
+#include "framescheduler.h"
+#include <QCoreApplication>
+
+/** ****************************************************************************
+ * @brief FrameScheduler::FrameScheduler
+ * @param parent
+ */
+FrameScheduler::FrameScheduler(QObject *parent) : QObject(parent)
+{
+    dispatchTimer.setSingleShot(true);
+    QObject::connect(&dispatchTimer, &QTimer::timeout, this, &FrameScheduler::Dispatch);
+}
+
+/** ****************************************************************************
+ * @brief FrameScheduler::RequestQuick requests a quick (low quality) frame
+ * @param isInput is true if the request comes from ongoing user input (a drag).
+ * Interactive requests postpone the upgrade to preview quality.
+ */
+void FrameScheduler::RequestQuick(bool isInput)
+{
+    quickPending = true;
+    if (isInput) {
+        sinceInput.start();
+    }
+    Schedule();
+}
+
+/** ****************************************************************************
+ * @brief FrameScheduler::RequestPreview requests a preview (high quality)
+ * frame. It's rendered once the input is idle.
+ */
+void FrameScheduler::RequestPreview()
+{
+    previewPending = true;
+    Schedule();
+}
+
+/** ****************************************************************************
+ * @brief FrameScheduler::RequestIdleWork requests that IdleWorkDue is emitted
+ * once no quick frame is pending. It takes priority over preview frames.
+ */
+void FrameScheduler::RequestIdleWork()
+{
+    idleWorkPending = true;
+    Schedule();
+}
+
+/** ****************************************************************************
+ * @brief FrameScheduler::InputActive
+ * @return true if there has been interactive input within idleUpgradeMs
+ */
+bool FrameScheduler::InputActive() const
+{
+    return sinceInput.isValid() && sinceInput.elapsed() < idleUpgradeMs;
+}
+
+/** ****************************************************************************
+ * @brief FrameScheduler::Schedule (re)starts the dispatch timer for the next
+ * pending frame
+ */
+void FrameScheduler::Schedule()
+{
+    if (!QCoreApplication::instance()) {
+        return; // Too early for timers. The next request will schedule the frame
+    }
+    qint64 delayMs;
+    if (quickPending) {
+        // Start quick frames no more often than the frame budget. Requests that
+        // arrive in between are coalesced into the next frame.
+        delayMs = sinceQuickStart.isValid() ? quickFrameBudgetMs - sinceQuickStart.elapsed() : 0;
+    }
+    else if (idleWorkPending) {
+        delayMs = 0;
+    }
+    else if (previewPending) {
+        delayMs = sinceInput.isValid() ? idleUpgradeMs - sinceInput.elapsed() : 0;
+    }
+    else {
+        dispatchTimer.stop();
+        return;
+    }
+    delayMs = qMax((qint64)0, delayMs);
+    if (!dispatchTimer.isActive() || dispatchTimer.remainingTime() > delayMs) {
+        dispatchTimer.start((int)delayMs);
+    }
+}
+
+/** ****************************************************************************
+ * @brief FrameScheduler::Dispatch emits the signal for the frame that's due
+ */
+void FrameScheduler::Dispatch()
+{
+    if (quickPending) {
+        quickPending = false;
+        sinceQuickStart.start();
+        emit QuickFrameDue();
+    }
+    else if (idleWorkPending) {
+        idleWorkPending = false;
+        emit IdleWorkDue();
+    }
+    else if (previewPending) {
+        if (InputActive()) {
+            // The input is still changing, so a preview would be outdated
+            // before it's finished. Wait for idle.
+        }
+        else {
+            previewPending = false;
+            emit PreviewFrameDue();
+        }
+    }
+    Schedule();
+}
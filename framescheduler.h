@@ -0,0 +1,50 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/** ****************************************************************************
+ * @brief The FrameScheduler class decides when quick and preview frames are
+ * rendered.
+ * Requests only set flags, so any number of requests made before a frame is
+ * rendered are coalesced into that one frame, and outdated requests are dropped.
+ * Quick frames are paced to the frame budget. Preview frames (which are slow)
+ * are only rendered once the input has been idle for a while, so they never
+ * hold up the quick frames of an active drag.
+ * Background work is done whenever no quick frame is due.
+ */
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr qint32 quickFrameBudgetMs = 16; // Target time per quick frame, during interaction
+    static constexpr qint32 idleUpgradeMs = 120; // Input idle time before upgrading to preview quality
+
+    explicit FrameScheduler(QObject *parent = nullptr);
+    void RequestQuick(bool isInput = true);
+    void RequestPreview();
+    void RequestIdleWork();
+    bool InputActive() const;
+
+signals:
+    void QuickFrameDue(); // Render a quick frame now
+    void PreviewFrameDue(); // Render a preview frame now
+    void IdleWorkDue(); // No frame is due. Do background work (e.g. prefetching) now
+
+private slots:
+    void Dispatch();
+
+private:
+    void Schedule();
+
+    QTimer dispatchTimer;
+    QElapsedTimer sinceInput; // Time since the last interactive request
+    QElapsedTimer sinceQuickStart; // Time since the last quick frame was started
+    bool quickPending = false;
+    bool previewPending = false;
+    bool idleWorkPending = false;
+};
+
+#endif // FRAMESCHEDULER_H
@@ -3,6 +3,10 @@
 #include "colourmap.h"
 #include "interact.h"
 #include "mainwindow.h"
+#include "fasttrig.h"
+#include "fourbar.h"
+#include "strokeraster.h"
+#include "pngstreamwriter.h"
 #include <QList>
 #include <QElapsedTimer>
 #include <QImage>
@@ -10,6 +14,10 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QFileDialog>
 #include <QCoreApplication>
+#include <QtConcurrent>
+#include <QThread>
+#include <QLineF>
+#include <cstring>
 #include <previewscene.h>
 
 ImageGen imageGen;
@@ -18,8 +26,25 @@ ImageGen imageGen;
  * @brief ImageGen::ImageGen
  */
 ImageGen::ImageGen() : colourMap(s.clrList, s.maskCfg, *this) {
-    QObject::connect(this, &ImageGen::GenerateImageSignal,
-                     this, &ImageGen::GenerateImageSlot, Qt::QueuedConnection);
+    FastTrig::Init();
+    InvalidateAll();
+    bool budgetOk = false;
+    qint64 budgetMB = qgetenv("WAVEPAPER_MEM_BUDGET_MB").toLongLong(&budgetOk);
+    if (budgetOk && budgetMB > 0) {
+        memBudgetBytes = budgetMB << 20;
+    }
+    QObject::connect(&scheduler, &FrameScheduler::QuickFrameDue,
+                     this, &ImageGen::RenderQuickFrame);
+    QObject::connect(&scheduler, &FrameScheduler::PreviewFrameDue,
+                     this, &ImageGen::RenderPreviewFrame);
+    QObject::connect(&scheduler, &FrameScheduler::IdleWorkDue,
+                     this, &ImageGen::RunPrefetch);
+    QObject::connect(&prefetchWatcher, &QFutureWatcher<PrefetchedTemplates*>::finished,
+                     this, &ImageGen::InstallPrefetchedTemplates);
+    animTimer.setTimerType(Qt::PreciseTimer);
+    animTimer.setInterval(animIntervalMs);
+    QObject::connect(&animTimer, &QTimer::timeout,
+                     this, &ImageGen::AnimationTick);
     colourMap.SetPreset(ClrMapPreset::hot);
 
     genPreview.clrIndexMax = 1023;
@@ -31,17 +56,8 @@ ImageGen::ImageGen() : colourMap(s.clrList, s.maskCfg, *this) {
     colourMap.CalcColourIndex(genQuick);
     colourMap.CalcMaskIndex(genQuick);
 
-    PreCalcTrigTables();
-}
-
-/** ****************************************************************************
- * @brief ImageGen::PreCalcTrigTables
- */
-void ImageGen::PreCalcTrigTables() {
-    double iToRad = 1. / (double)trigTableLen * 2. * PI;
-    for (int i=0; i < trigTableLen; i++) {
-        sincos(i*iToRad, &sinTable[i], &cosTable[i]);
-    }
+    StageBuilt(genPreview, Stage::colourLut);
+    StageBuilt(genQuick, Stage::colourLut);
 }
 
 /** ****************************************************************************
@@ -49,51 +65,101 @@ void ImageGen::PreCalcTrigTables() {
  */
 void ImageGen::NewImageNeeded() {
     // The quick image should be drawn first, and the preview image after
-    pendingQuickImage = true;
-    pendingPreviewImage = true;
-    emit GenerateImageSignal(); // Process it later in the event queue
+    scheduler.RequestQuick(false);
+    scheduler.RequestPreview();
+    emit GenerateImageSignal();
 }
 
 /** ****************************************************************************
  * @brief ImageGen::NewPreviewImageNeeded
  */
 void ImageGen::NewPreviewImageNeeded() {
-    pendingPreviewImage = true;
-    emit GenerateImageSignal(); // Process it later in the event queue
+    scheduler.RequestPreview();
+    emit GenerateImageSignal();
 }
 
 /** ****************************************************************************
- * @brief ImageGen::NewQuickImageNeeded
+ * @brief ImageGen::NewQuickImageNeeded is called during interaction (drags).
+ * The image is upgraded to preview quality once the interaction goes idle.
  */
 void ImageGen::NewQuickImageNeeded() {
-    pendingQuickImage = true;
-    emit GenerateImageSignal(); // Process it later in the event queue
+    scheduler.RequestQuick();
+    scheduler.RequestPreview();
+    emit GenerateImageSignal();
 }
 
 
 /** ****************************************************************************
- * @brief ImageGen::GenerateImageSlot
+ * @brief ImageGen::RenderQuickFrame is called by the scheduler
  */
-void ImageGen::GenerateImageSlot()
+void ImageGen::RenderQuickFrame()
 {
-    // Draw a 'quick' image with a higher priority than the more detailed 'preview' image
-    bool handled = false;
-    if (pendingQuickImage) {
-        handled = true;
-        GenerateImage(imgQuick, genQuick);
-        emit NewImageReady(imgQuick, genQuick.imgPerSimUnit, s.maskCfg.backColour);
-        pendingQuickImage = false;
-    }
-    if (pendingPreviewImage) {
-        if (handled) {
-            emit GenerateImageSignal(); // Process it next time
-        }
-        else {
-            handled = true;
-            GenerateImage(imgPreview, genPreview);
-            emit NewImageReady(imgPreview, genPreview.imgPerSimUnit, s.maskCfg.backColour);
-            pendingPreviewImage = false;
-        }
+    RenderFrame(genQuick);
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::RenderPreviewFrame is called by the scheduler
+ */
+void ImageGen::RenderPreviewFrame()
+{
+    RenderFrame(genPreview);
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::RenderFrame renders into the frame queue's in-flight buffer
+ * (reusing its pixel allocation), and publishes it for display
+ * @param genSet
+ * @return true if a frame was published
+ */
+bool ImageGen::RenderFrame(GenSettings &genSet)
+{
+    Frame& frame = frameQueue.BeginRender();
+    if (GenerateImage(frame.image, genSet) != 0) {
+        return false;
+    }
+    frame.imgPerSimUnit = genSet.imgPerSimUnit;
+    frame.backgroundClr = s.maskCfg.backColour;
+    frameQueue.PublishRender();
+    emit NewFrameReady();
+    if (&genSet == &genQuick) {
+        AdaptQuickImgPoints(genSet);
+    }
+    return true;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::AdaptQuickImgPoints is a feedback controller for the quick
+ * image size. Generation time is roughly proportional to the number of pixels,
+ * so the pixel count is scaled towards the frame budget, based on the measured
+ * time of the last quick frame.
+ * One-off stages (template and colour index rebuilds) are excluded, as they
+ * don't recur every frame. The result is quantised into ~9% steps with a
+ * dead band, so that the image size (and therefore the templates) doesn't
+ * change every frame.
+ * @param genSet is the quick image generation settings
+ */
+void ImageGen::AdaptQuickImgPoints(const GenSettings &genSet)
+{
+    const qreal budgetMs = FrameScheduler::quickFrameBudgetMs;
+    qreal steadyMs = qMax((qreal)1., (qreal)(genSet.lastFrameMs - genSet.lastOneOffMs));
+    qreal ratio = budgetMs / steadyMs;
+    if (ratio > 0.75 && ratio < 1.5) {
+        return; // Close enough to the budget
+    }
+    // Damped step towards the budget. The step is applied to quickImgPoints
+    // itself, as the image actually rendered may be smaller (e.g. an integer
+    // divisor of the view size in pixel-exact mode)
+    ratio = pow(qBound(0.25, ratio, 4.), 0.7);
+    qreal newPoints = qBound((qreal)minImgPointsQuick, quickImgPoints * ratio, (qreal)maxImgPointsQuick);
+    newPoints = pow(2., qRound(log2(newPoints) * 8.) / 8.); // Quantise
+    if (qAbs(newPoints / quickImgPoints - 1.) < 0.05) {
+        return;
+    }
+    qDebug("AdaptQuickImgPoints: %.0fms for %.0f points (target %.0f). Changing target to %.0f points",
+           steadyMs, genSet.targetImgPoints, quickImgPoints, newPoints);
+    quickImgPoints = newPoints;
+    if (mainWindow && mainWindow->previewView) {
+        mainWindow->previewView->UpdateImageSizes();
     }
 }
 
@@ -110,7 +176,7 @@ int ImageGen::InitViewAreas() {
     mainWindow->previewView->setSceneRect(QRectF()); // Ensures that the scene's property is used
 
     setTargetImgPoints(GenSettings::dfltImgPointsPreview, genPreview);
-    setTargetImgPoints(GenSettings::dfltImgPointsQuick, genQuick);
+    setTargetImgPoints((qint32)quickImgPoints, genQuick);
 
     if (mainWindow->previewView != nullptr) {mainWindow->previewView->OnAspectRatioChange();}
     return 0;
@@ -122,10 +188,15 @@ int ImageGen::InitViewAreas() {
  */
 void ImageGen::setTargetImgPoints(qint32 imgPoints, GenSettings & genSet) const {
     // Determine the viewing window in image coordinates
+    double imgPerSimUnitPrev = genSet.imgPerSimUnit;
+    QRect areaImgPrev = genSet.areaImg;
     genSet.targetImgPoints = imgPoints;
     genSet.imgPerSimUnit = sqrt(genSet.targetImgPoints / areaSim.width() / areaSim.height());
     QRectF areaImgF(areaSim.topLeft() * genSet.imgPerSimUnit, areaSim.bottomRight() * genSet.imgPerSimUnit);
     genSet.areaImg = areaImgF.toRect();
+    if (genSet.imgPerSimUnit != imgPerSimUnitPrev || genSet.areaImg != areaImgPrev) {
+        ResetImageStages(genSet);
+    }
 
     if (std::abs(areaSim.width() / areaSim.height() /
             (qreal)genSet.areaImg.width() * (qreal)genSet.areaImg.height() - 1) > 0.02) {
@@ -135,6 +206,278 @@ void ImageGen::setTargetImgPoints(qint32 imgPoints, GenSettings & genSet) const
     genSet.pointsPerRev = 200; // TODO Where should this be set?
 }
 
+/** ****************************************************************************
+ * @brief ImageGen::setTargetImgSize sets the image to an exact pixel size,
+ * rather than a target number of points. Used to render images that map 1:1
+ * (or by an integer factor) onto device pixels.
+ * @param imgSize must have (close to) the same aspect ratio as areaSim
+ */
+void ImageGen::setTargetImgSize(QSize imgSize, GenSettings & genSet) const {
+    double imgPerSimUnitPrev = genSet.imgPerSimUnit;
+    QRect areaImgPrev = genSet.areaImg;
+    genSet.targetImgPoints = imgSize.width() * imgSize.height();
+    genSet.imgPerSimUnit = (qreal)imgSize.width() / areaSim.width();
+    QPoint topLeft(qRound(areaSim.left() * genSet.imgPerSimUnit), qRound(areaSim.top() * genSet.imgPerSimUnit));
+    genSet.areaImg = QRect(topLeft, imgSize);
+    if (genSet.imgPerSimUnit != imgPerSimUnitPrev || genSet.areaImg != areaImgPrev) {
+        ResetImageStages(genSet);
+    }
+
+    if (std::abs(areaSim.width() / areaSim.height() /
+            (qreal)genSet.areaImg.width() * (qreal)genSet.areaImg.height() - 1) > 0.02) {
+        qFatal("setTargetImgSize: viewWindow and simWindow are different ratios!");
+    }
+
+    genSet.pointsPerRev = 200;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::ResetImageStages marks every stage of genSet that's cached
+ * in image coordinates as out of date. Called when the image size or scale
+ * changes. The colour indices don't depend on the image, so are kept.
+ * @param genSet
+ */
+void ImageGen::ResetImageStages(GenSettings &genSet) {
+    for (Stage stage : {Stage::emitters, Stage::templates, Stage::sum, Stage::normalise,
+                        Stage::colouring, Stage::fourBarGeom}) {
+        genSet.builtVersion[stage] = 0;
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::Invalidate marks a pipeline stage as out of date, along with
+ * every stage that depends on it. Stages are rebuilt by the next frame that
+ * uses them.
+ * The dependencies are:
+ *   emitters -> templates -> sum -> normalise -> colouring
+ *   colourLut -> colouring
+ *   fourBarGeom -> colouring
+ * (the template size depends on the emitter locations)
+ * @param stage
+ */
+void ImageGen::Invalidate(Stage stage) {
+    stageVersion[stage] = ++stageSerial;
+    switch (stage) {
+    case Stage::emitters:
+        Invalidate(Stage::templates);
+        break;
+    case Stage::templates:
+        Invalidate(Stage::sum);
+        break;
+    case Stage::sum:
+        Invalidate(Stage::normalise);
+        break;
+    case Stage::normalise:
+    case Stage::colourLut:
+    case Stage::fourBarGeom:
+        Invalidate(Stage::colouring);
+        break;
+    case Stage::colouring:
+    case Stage::count:
+        break;
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::InvalidateAll marks every pipeline stage as out of date
+ */
+void ImageGen::InvalidateAll() {
+    for (qint32 i = 0; i < (qint32)Stage::count; i++) {
+        Invalidate((Stage)i);
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::InvalidateField is called after a setting is edited. It maps
+ * the setting to the pipeline stages that depend on it, and invalidates them.
+ * @param field is the address of the edited setting (or the struct containing
+ * it) within s, or within one of s.emArrangements. Other addresses (such as
+ * outHeightPix) don't affect the pattern, and are ignored.
+ */
+void ImageGen::InvalidateField(const void *field) {
+    auto within = [field](const void* base, size_t size) {
+        return (const char*)field >= (const char*)base && (const char*)field < (const char*)base + size;
+    };
+    for (const EmArrangement& arn : s.emArrangements) {
+        if (within(&arn, sizeof(arn))) {
+            Invalidate(Stage::emitters);
+            return;
+        }
+    }
+    if (!within(&s, sizeof(s))) {
+        return;
+    }
+
+    if (field == &s.wavelength) {
+        // The templates don't depend on the wavelength
+        Invalidate(Stage::sum);
+    }
+    else if (field == &s.distOffsetF) {
+        Invalidate(Stage::templates);
+    }
+    else if (field == &s.spectralMode) {
+        // The number of sums changes, so the memory budget is checked again
+        // with the templates. They're only rebuilt if the budget degrades them
+        Invalidate(Stage::templates);
+    }
+    else if (field == &s.fieldMode) {
+        // The cached sum is reused
+        Invalidate(Stage::normalise);
+    }
+    else if (field == &s.emArrangements || field == &s.emittersInSync || field == &s.energizerDistOffsetF ||
+             within(&s.energizerLoc, sizeof(s.energizerLoc))) {
+        Invalidate(Stage::emitters);
+    }
+    else if (field == &s.clrList || within(&s.maskCfg, sizeof(s.maskCfg))) {
+        Invalidate(Stage::colourLut);
+    }
+    else if (within(&s.fourBar, sizeof(s.fourBar))) {
+        Invalidate(Stage::fourBarGeom);
+    }
+    else if (field == &s.emitterRadius) {
+        // Only affects the overlay
+    }
+    else {
+        InvalidateAll();
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::OtherCacheBytes
+ * @param genSet
+ * @return the memory held by caches other than those of genSet. genSet may be
+ * the settings of an image being saved
+ */
+qint64 ImageGen::OtherCacheBytes(const GenSettings &genSet) const {
+    qint64 bytes = (qint64)BufferPool::Instance().CachedBytes();
+    for (const GenSettings* other : {&genPreview, &genQuick}) {
+        if (other != &genSet) {
+            bytes += other->CacheBytes();
+        }
+    }
+    return bytes;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::ProjectedCacheBytes estimates the memory that genSet will
+ * hold once the templates & sum have been built
+ * @param genSet
+ * @param templateRect is the minimum required template size
+ * @param oversize true if the templates are made larger than required
+ * @param phasorTemplate true if the phasor template is used
+ * @return the estimate [bytes]
+ */
+qint64 ImageGen::ProjectedCacheBytes(const GenSettings &genSet, QRect templateRect, bool oversize, bool phasorTemplate) const {
+    qreal factor = oversize ? templateOversizeFactor : 1.;
+    qint64 templatePoints = (qint64)(templateRect.width() * factor + 1) * (qint64)(templateRect.height() * factor + 1);
+    if (oversize && genSet.templateDist.arr && genSet.templateDist.arr->rect().contains(templateRect)) {
+        // The existing templates are kept
+        QRect existing = genSet.templateDist.arr->rect();
+        templatePoints = (qint64)existing.width() * existing.height();
+    }
+    qint64 bytesPerTemplatePoint = 2 * sizeof(double) + (phasorTemplate ? sizeof(PackedPhasor) : 0);
+    qint64 imgPoints = (qint64)genSet.areaImg.width() * genSet.areaImg.height();
+    qint64 sumCount = s.spectralMode ? GenSettings::spectralCount : 1;
+    qint64 bytes = templatePoints * bytesPerTemplatePoint +
+            imgPoints * (sumCount * (sizeof(std::complex<double>) + sizeof(double)) + sizeof(QRgb));
+    return bytes;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::EnsureMemory is called before the templates of genSet are
+ * rebuilt. If the projected memory use exceeds the budget, memory is freed in
+ * this order, until it fits:
+ *   1. The free buffers held by the buffer pool
+ *   2. The caches of other GenSettings, least recently used first
+ *   3. The template oversize (templates are rebuilt to the minimum size)
+ *   4. The phasor template (phasors are calculated while summing, which is slower)
+ * The full quality mode is restored as soon as it fits again.
+ * @param genSet
+ * @param templateRect is the minimum required template size
+ * @return true if the image fits within the budget. False if it can't be
+ * generated at all
+ */
+bool ImageGen::EnsureMemory(GenSettings &genSet, QRect templateRect) {
+    auto fits = [&](bool oversize, bool phasorTemplate) {
+        return OtherCacheBytes(genSet) + ProjectedCacheBytes(genSet, templateRect, oversize, phasorTemplate) <= memBudgetBytes;
+    };
+    if (fits(true, true)) {
+        SetTemplateMode(genSet, true, true);
+        return true;
+    }
+
+    BufferPool::Instance().Trim();
+
+    QVector<GenSettings*> others;
+    for (GenSettings* other : {&genPreview, &genQuick}) {
+        if (other != &genSet && other->CacheBytes() > 0) {
+            others.append(other);
+        }
+    }
+    std::sort(others.begin(), others.end(), [](const GenSettings* a, const GenSettings* b) {
+        return a->lastUsed < b->lastUsed;
+    });
+    for (GenSettings* other : others) {
+        if (fits(true, true)) {
+            break;
+        }
+        qDebug("ImageGen::EnsureMemory: releasing %lld MB of cached arrays", other->CacheBytes() >> 20);
+        other->ReleaseCaches();
+    }
+
+    for (bool phasorTemplate : {true, false}) {
+        for (bool oversize : {true, false}) {
+            if (fits(oversize, phasorTemplate)) {
+                if (!oversize || !phasorTemplate) {
+                    qDebug("ImageGen::EnsureMemory: degraded to oversize=%d, phasorTemplate=%d to fit within %lld MB",
+                           oversize, phasorTemplate, memBudgetBytes >> 20);
+                }
+                SetTemplateMode(genSet, oversize, phasorTemplate);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::SetTemplateMode sets how the templates of genSet are built,
+ * deleting the templates that don't suit the new mode
+ * @param genSet
+ * @param oversize true to make the templates larger than required
+ * @param phasorTemplate true to use the phasor template
+ */
+void ImageGen::SetTemplateMode(GenSettings &genSet, bool oversize, bool phasorTemplate) {
+    if (!phasorTemplate) {
+        // Free before the templates are rebuilt
+        delete genSet.templatePhasor.arr;
+        genSet.templatePhasor.arr = nullptr;
+    }
+    if (!oversize && genSet.templateOversize) {
+        // Rebuild the templates at the minimum size
+        delete genSet.templateDist.arr;
+        genSet.templateDist.arr = nullptr;
+        delete genSet.templateAmp.arr;
+        genSet.templateAmp.arr = nullptr;
+        delete genSet.templatePhasor.arr;
+        genSet.templatePhasor.arr = nullptr;
+    }
+    genSet.templateOversize = oversize;
+    genSet.usePhasorTemplate = phasorTemplate;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::PixelDivisor
+ * @param devicePixSize
+ * @param maxImgPoints
+ * @return the smallest integer divisor of devicePixSize that results in an
+ * image of no more than maxImgPoints pixels
+ */
+qint32 ImageGen::PixelDivisor(QSize devicePixSize, qreal maxImgPoints) {
+    qreal devicePoints = (qreal)devicePixSize.width() * devicePixSize.height();
+    return std::max(1, (qint32)ceil(sqrt(devicePoints / maxImgPoints)));
+}
+
 /** ****************************************************************************
  * @brief ImageGen::EmittersHidden
  * @return
@@ -165,6 +508,20 @@ void ImageGen::SaveImage()
         genFinal.pointsPerRev = 400;
         QImage imgFinal;
 
+        if (mainWindow->programMode == ProgramMode::fourBar) {
+            emit OverlayTextSignal(QString::asprintf("Rendering image %.1fM pixels in tiles.",
+                                                     (qreal)genFinal.targetImgPoints / 1000000.));
+            QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents); // Render the new overlay text immediately (somewhat risky)
+            if (s.fourBar.densityMode) {
+                SaveImageFourBarDensityTiled(fileName, genFinal);
+            }
+            else {
+                SaveImageFourBarTiled(fileName, genFinal);
+            }
+            emit OverlayTextSignal(QString());
+            return;
+        }
+
         QVector<EmitterF> emittersF;
         if (GetEmitterList(emittersF)) { return; }
         emit OverlayTextSignal(QString::asprintf("Rendering image %.1fM pixels for %d emitters.",
@@ -172,20 +529,376 @@ void ImageGen::SaveImage()
         QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents); // Render the new overlay text immediately (somewhat risky)
 
         if (GenerateImage(imgFinal, genFinal) == 0) {
-            if (s.maskCfg.enabled && !saveWithTransparency) {
-                QImage imgComplete(imgFinal.size(), imgFinal.format());
-                QPainter painter(&imgComplete);
-                //painter.setBackground(QBrush(colourMap.GetMaskConfig().backColour));
-                painter.fillRect(imgFinal.rect(), s.maskCfg.backColour);
-                painter.drawImage(0,0, imgFinal);
-                imgComplete.save(fileName);
+            ImageForSave(imgFinal).save(fileName);
+        }
+        emit OverlayTextSignal(QString());
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::ImageForSave
+ * @param img is a generated image
+ * @return the image to save. With a mask, the background colour is rendered
+ * into it, unless it's saved with transparency.
+ */
+QImage ImageGen::ImageForSave(const QImage &img) const
+{
+    if (!s.maskCfg.enabled || saveWithTransparency) {
+        return img;
+    }
+    QImage imgComplete(img.size(), img.format());
+    QPainter painter(&imgComplete);
+    painter.fillRect(img.rect(), s.maskCfg.backColour);
+    painter.drawImage(0,0, img);
+    return imgComplete;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::SaveAnimation saves one period of the time phase animation
+ * as a PNG sequence: <name>_0000.png, <name>_0001.png, ...
+ * The phasor sum is calculated once. Each frame only rotates the phase and
+ * colours the image. The PNGs are encoded in parallel with the next frames.
+ */
+void ImageGen::SaveAnimation()
+{
+    if (mainWindow->programMode != ProgramMode::waves) {
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(mainWindow, tr("Save animation"),
+                                                    QString(),
+                                                    tr("Images (*.png)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (fileName.endsWith(".png", Qt::CaseInsensitive)) {
+        fileName.chop(4);
+    }
+
+    GenSettings genFinal;
+    setTargetImgPoints( qreal(outHeightPix * outHeightPix) / s.view.aspectRatio, genFinal);
+    genFinal.indexedClr = false; // Use accurate colours
+
+    animTimer.stop();
+    qreal animTurnsBackup = animTurns;
+    exportingAnimation = true;
+    QList<QFuture<bool>> saves;
+    bool ok = true;
+    for (qint32 i = 0; i < animExportFrames && ok; i++) {
+        emit OverlayTextSignal(QString::asprintf("Rendering animation frame %d of %d (%.1fM pixels).",
+                                                 i + 1, animExportFrames, (qreal)genFinal.targetImgPoints / 1000000.));
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents); // Render the new overlay text immediately (somewhat risky)
+        animTurns = (qreal)i / animExportFrames;
+        Invalidate(Stage::normalise);
+        QImage frame;
+        if (GenerateImage(frame, genFinal) != 0) {
+            ok = false;
+            break;
+        }
+        QImage img = ImageForSave(frame);
+        QString frameName = fileName + QString::asprintf("_%04d.png", i);
+        saves.append(QtConcurrent::run([img, frameName]() {return img.save(frameName);}));
+        // Limit the frames held in memory
+        while (saves.size() >= QThread::idealThreadCount()) {
+            ok &= saves.takeFirst().result();
+        }
+    }
+    for (QFuture<bool>& save : saves) {
+        ok &= save.result();
+    }
+    if (!ok) {
+        qWarning() << "ImageGen::SaveAnimation failed to save" << fileName;
+    }
+
+    exportingAnimation = false;
+    animTurns = animTurnsBackup;
+    Invalidate(Stage::normalise);
+    if (animating) {
+        animTurnsStart = animTurns;
+        animClock.start();
+        animTimer.start();
+    }
+    NewPreviewImageNeeded();
+    emit OverlayTextSignal(QString());
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::SetAnimating starts or stops the time phase animation. The
+ * real part of the field is displayed while animating. Each frame reuses the
+ * phasor sum, so only the displayed values & colours are recalculated.
+ * @param animate
+ */
+void ImageGen::SetAnimating(bool animate)
+{
+    if (animate && mainWindow->programMode != ProgramMode::waves) {
+        return;
+    }
+    if (animate == animating) {
+        return;
+    }
+    animating = animate;
+    if (animating) {
+        animTurnsStart = animTurns;
+        animClock.start();
+        animTimer.start();
+    }
+    else {
+        animTimer.stop();
+    }
+    Invalidate(Stage::normalise);
+    NewPreviewImageNeeded();
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::AnimationTick advances the time phase, and requests a quick
+ * frame. The quick image size adapts to keep up with the frame rate.
+ */
+void ImageGen::AnimationTick()
+{
+    if (mainWindow->programMode != ProgramMode::waves) {
+        SetAnimating(false);
+        return;
+    }
+    animTurns = std::fmod(animTurnsStart + animClock.elapsed() * 0.001 * animTurnsPerSec, 1.);
+    Invalidate(Stage::normalise);
+    NewQuickImageNeeded();
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::SaveImageFourBarTiled renders the four bar path in tiles,
+ * and saves it.
+ * Segments are first binned by the tiles that they touch. A row of tiles is
+ * then rasterised in parallel (one tile per task), and written out before the
+ * next row is started. Large images are streamed to the file row by row with
+ * PngStreamWriter, so the whole image is never held in memory. Smaller images
+ * are assembled and saved normally (with compression).
+ * @param fileName
+ * @param genSet
+ * @return 0 for pass
+ */
+int ImageGen::SaveImageFourBarTiled(const QString &fileName, GenSettings &genSet) {
+    QElapsedTimer fnTimer;
+    fnTimer.start();
+
+    auto& fb = s.fourBar;
+    QSize imgSize = genSet.areaImg.size();
+    QRect imgRect(QPoint(0, 0), imgSize);
+    qint32 stepCount = FourBar::StepCount(fb, genSet.pointsPerRev);
+    FourBar::PathTransform tf = FourBar::MakeTransform(fb, imgSize);
+    FourBar::Geometry geometry; // Not shared, since saves use their own pointsPerRev & tolerance
+    FourBar::UpdateGeometry(fb, genSet.pointsPerRev, FourBar::GeometryTolerance(genSet.chordTolerance, tf.scale),
+                            stepCount, geometry);
+    const FourBarPath& path = geometry.path;
+    FourBar::StrokeStyle style = FourBar::MakeStrokeStyle(fb, imgSize, genSet.pointsPerRev);
+
+    // Spatial index: the segments that touch each tile
+    const qint32 tilesX = (imgSize.width() + exportTileSize - 1) / exportTileSize;
+    const qint32 tilesY = (imgSize.height() + exportTileSize - 1) / exportTileSize;
+    QVector<QVector<qint32>> tileSegments(tilesX * tilesY);
+    for (qint32 step = 1; step < path.Count(); step++) {
+        QRectF bounds = FourBar::SegmentBounds(path, tf, style, step);
+        if (bounds.isNull() || !bounds.intersects(imgRect)) {
+            continue;
+        }
+        qint32 tx0 = qBound(0, (qint32)floor(bounds.left() / exportTileSize), tilesX - 1);
+        qint32 tx1 = qBound(0, (qint32)floor(bounds.right() / exportTileSize), tilesX - 1);
+        qint32 ty0 = qBound(0, (qint32)floor(bounds.top() / exportTileSize), tilesY - 1);
+        qint32 ty1 = qBound(0, (qint32)floor(bounds.bottom() / exportTileSize), tilesY - 1);
+        for (qint32 ty = ty0; ty <= ty1; ty++) {
+            for (qint32 tx = tx0; tx <= tx1; tx++) {
+                tileSegments[ty * tilesX + tx].append(step);
             }
-            else {
-                imgFinal.save(fileName);
+        }
+    }
+    qint64 binMs = fnTimer.elapsed();
+
+    bool streamed = (qint64)imgSize.width() * imgSize.height() > streamExportMinPixels;
+    PngStreamWriter writer;
+    QImage imgComplete;
+    if (streamed) {
+        if (writer.Open(fileName, imgSize.width(), imgSize.height())) {
+            qWarning("SaveImageFourBarTiled: could not write %s", qPrintable(fileName));
+            return -1;
+        }
+    }
+    else {
+        imgComplete = QImage(imgSize, QImage::Format_ARGB32);
+    }
+
+    QVector<QImage> bandTiles(tilesX);
+    QImage* bandTileData = bandTiles.data();
+    QVector<qint32> tileColumns;
+    for (qint32 tx = 0; tx < tilesX; tx++) {
+        tileColumns.append(tx);
+    }
+    QVector<QRgb> rowPixels(imgSize.width());
+    for (qint32 ty = 0; ty < tilesY; ty++) {
+        QtConcurrent::blockingMap(tileColumns, [&](const qint32& tx) {
+            QRect tileRect = QRect(tx * exportTileSize, ty * exportTileSize,
+                                   exportTileSize, exportTileSize) & imgRect;
+            QImage& tile = bandTileData[tx];
+            tile = QImage(tileRect.size(), QImage::Format_ARGB32);
+            tile.fill(Qt::black);
+            RasterTarget target = RasterTarget::FromTile(tile, tileRect.topLeft());
+            for (qint32 step : tileSegments.at(ty * tilesX + tx)) {
+                FourBar::DrawSegment(path, tf, style, target, step);
+            }
+        });
+
+        // Output this row of tiles
+        qint32 bandHeight = bandTiles[0].height();
+        for (qint32 y = 0; y < bandHeight; y++) {
+            QRgb* outLine = streamed ? rowPixels.data() : (QRgb*)imgComplete.scanLine(ty * exportTileSize + y);
+            for (qint32 tx = 0; tx < tilesX; tx++) {
+                const QImage& tile = bandTiles[tx];
+                memcpy(outLine + tx * exportTileSize, tile.constScanLine(y), tile.width() * sizeof(QRgb));
+            }
+            if (streamed) {
+                writer.WriteRow(outLine);
             }
         }
-        emit OverlayTextSignal(QString());
+        for (qint32 tx = 0; tx < tilesX; tx++) {
+            tileSegments[ty * tilesX + tx] = QVector<qint32>(); // Free as we go
+        }
     }
+
+    int ret = streamed ? writer.Close() : (imgComplete.save(fileName) ? 0 : -2);
+
+    QString imgGenTime = \
+            QString::asprintf("SaveImage tiled %4lld ms (binning %lld ms). (%dx%d, %dx%d tiles%s)",
+                              fnTimer.elapsed(), binMs, imgSize.width(), imgSize.height(),
+                              tilesX, tilesY, streamed ? ", streamed" : "");
+    qDebug() << imgGenTime;
+    mainWindow->textWindow->appendPlainText(imgGenTime);
+    return ret;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::SaveImageFourBarDensityTiled renders the four bar density
+ * image in bands of rows, and saves it.
+ * Segments are binned by the bands that they touch. The tone mapping needs the
+ * peak density of the whole image, so the bands are splatted twice: first to
+ * find the peak, then to colour and write them out in order. A group of bands
+ * (one per thread) is splatted at a time, so only that group's buffers are
+ * held. As with SaveImageFourBarTiled, large images are streamed to the file.
+ * @param fileName
+ * @param genSet
+ * @return 0 for pass
+ */
+int ImageGen::SaveImageFourBarDensityTiled(const QString &fileName, GenSettings &genSet) {
+    QElapsedTimer fnTimer;
+    fnTimer.start();
+
+    auto& fb = s.fourBar;
+    QSize imgSize = genSet.areaImg.size();
+    const qint32 w = imgSize.width();
+    const qint32 h = imgSize.height();
+    qint32 stepCount = FourBar::StepCount(fb, genSet.pointsPerRev);
+    FourBar::PathTransform tf = FourBar::MakeTransform(fb, imgSize);
+    FourBar::Geometry geometry; // Not shared, since saves use their own pointsPerRev & tolerance
+    FourBar::UpdateGeometry(fb, genSet.pointsPerRev, FourBar::GeometryTolerance(genSet.chordTolerance, tf.scale),
+                            stepCount, geometry);
+    const FourBarPath& path = geometry.path;
+    const qint32 bandRows = FourBar::densityBandRows;
+    QVector<QVector<qint32>> bandSegments;
+    FourBar::BinDensityBands(path, path.PointsUpTo(stepCount - 1), tf, imgSize, bandRows, bandSegments);
+    const qint32 bandCount = bandSegments.size();
+    UpdateColourIndex(genSet);
+    qint64 binMs = fnTimer.elapsed();
+
+    // Splats the bands groupFirst to groupFirst + groupLen - 1, one per task.
+    // If colour is true, they're also coloured with mult
+    qreal mult = 0;
+    const qint32 groupLen = qMax(1, QThread::idealThreadCount());
+    QVector<QVector<float>> bandDensity(groupLen);
+    QVector<QVector<QRgb>> bandPixels(groupLen);
+    QVector<float>* bandDensityData = bandDensity.data(); // Detached once, before the threads start
+    QVector<QRgb>* bandPixelData = bandPixels.data();
+    auto splatGroup = [&](qint32 groupFirst, bool colour) {
+        QVector<qint32> tasks;
+        for (qint32 i = 0; i < groupLen && groupFirst + i < bandCount; i++) {
+            tasks.append(i);
+        }
+        QtConcurrent::blockingMap(tasks, [&](const qint32& i) {
+            const qint32 rowFirst = (groupFirst + i) * bandRows;
+            const qint32 rowCount = qMin(bandRows, h - rowFirst);
+            QVector<float>& density = bandDensityData[i];
+            density.fill(0.f, rowCount * w);
+            FourBar::SplatBand(path, tf, imgSize, bandSegments.at(groupFirst + i),
+                               rowFirst, rowFirst + rowCount, density.data());
+            if (colour) {
+                bandPixelData[i].resize(rowCount * w);
+                for (qint32 y = 0; y < rowCount; y++) {
+                    ToneMapDensityRow(density.constData() + y * w, w, mult,
+                                      bandPixelData[i].data() + y * w, genSet);
+                }
+            }
+        });
+        return tasks.size();
+    };
+
+    // Pass 1: the peak density
+    float maxDensity = 0;
+    for (qint32 groupFirst = 0; groupFirst < bandCount; groupFirst += groupLen) {
+        qint32 count = splatGroup(groupFirst, false);
+        for (qint32 i = 0; i < count; i++) {
+            for (float d : bandDensity[i]) {
+                maxDensity = qMax(maxDensity, d);
+            }
+        }
+    }
+    mult = DensityToneScale(maxDensity);
+    qint64 peakMs = fnTimer.elapsed() - binMs;
+
+    bool streamed = (qint64)w * h > streamExportMinPixels;
+    PngStreamWriter writer;
+    QImage imgComplete;
+    if (streamed) {
+        if (writer.Open(fileName, w, h)) {
+            qWarning("SaveImageFourBarDensityTiled: could not write %s", qPrintable(fileName));
+            return -1;
+        }
+    }
+    else {
+        imgComplete = QImage(imgSize, QImage::Format_ARGB32);
+    }
+
+    // Pass 2: colour & write out. The background is rendered in, as in ImageForSave
+    const bool blendBackground = s.maskCfg.enabled && !saveWithTransparency;
+    const QRgb back = s.maskCfg.backColour.rgb();
+    for (qint32 groupFirst = 0; groupFirst < bandCount; groupFirst += groupLen) {
+        qint32 count = splatGroup(groupFirst, true);
+        for (qint32 i = 0; i < count; i++) {
+            const qint32 rowFirst = (groupFirst + i) * bandRows;
+            const qint32 rowCount = qMin(bandRows, h - rowFirst);
+            QRgb* pixels = bandPixels[i].data();
+            if (blendBackground) {
+                for (qint32 p = 0; p < rowCount * w; p++) {
+                    const qint32 a = qAlpha(pixels[p]);
+                    pixels[p] = qRgb((qRed(pixels[p]) * a + qRed(back) * (255 - a)) / 255,
+                                     (qGreen(pixels[p]) * a + qGreen(back) * (255 - a)) / 255,
+                                     (qBlue(pixels[p]) * a + qBlue(back) * (255 - a)) / 255);
+                }
+            }
+            for (qint32 y = 0; y < rowCount; y++) {
+                if (streamed) {
+                    writer.WriteRow(pixels + y * w);
+                }
+                else {
+                    memcpy(imgComplete.scanLine(rowFirst + y), pixels + y * w, w * sizeof(QRgb));
+                }
+            }
+            bandSegments[groupFirst + i] = QVector<qint32>(); // Free as we go
+        }
+    }
+
+    int ret = streamed ? writer.Close() : (imgComplete.save(fileName) ? 0 : -2);
+
+    QString imgGenTime = \
+            QString::asprintf("SaveImage density %4lld ms (binning %lld ms, peak %lld ms). (%dx%d, %d bands%s)",
+                              fnTimer.elapsed(), binMs, peakMs, w, h, bandCount, streamed ? ", streamed" : "");
+    qDebug() << imgGenTime;
+    mainWindow->textWindow->appendPlainText(imgGenTime);
+    return ret;
 }
 
 /** ****************************************************************************
@@ -195,6 +908,7 @@ void ImageGen::SaveImage()
 void ImageGen::AddArrangement(EmArrangement emArrangementIn)
 {
     s.emArrangements.append(emArrangementIn);
+    Invalidate(Stage::emitters);
 
     // Add the value editors here !@#
 }
@@ -205,6 +919,7 @@ void ImageGen::AddArrangement(EmArrangement emArrangementIn)
 void ImageGen::ResetSettings()
 {
     s = Settings();
+    InvalidateAll();
     colourMap.SetPreset(ClrMapPreset::hot);
     NewImageNeeded();
     mainWindow->InitMode();
@@ -217,6 +932,7 @@ void ImageGen::ResetSettings()
 void ImageGen::EmitterCountIncrease() {
     EmArrangement * group = GetActiveArrangement();
     group->count = std::max(group->count + 1, qRound((qreal)group->count * 1.2));
+    Invalidate(Stage::emitters);
     NewImageNeeded();
     emit EmitterArngmtChanged();
 }
@@ -230,6 +946,7 @@ void ImageGen::EmitterCountDecrease() {
     int prevVal = group->count;
     group->count = std::max(1, std::min(group->count - 1, qRound((qreal)group->count * 0.8)));
     if (group->count != prevVal) {
+        Invalidate(Stage::emitters);
         NewImageNeeded();
         emit EmitterArngmtChanged();
     }
@@ -241,6 +958,7 @@ void ImageGen::EmitterCountDecrease() {
 void ImageGen::WavelengthDecrease()
 {
     this->s.wavelength *= 0.8;
+    InvalidateField(&s.wavelength);
     NewImageNeeded();
 }
 
@@ -250,6 +968,7 @@ void ImageGen::WavelengthDecrease()
 void ImageGen::WavelengthIncrease()
 {
     this->s.wavelength *= 1.25;
+    InvalidateField(&s.wavelength);
     NewImageNeeded();
 }
 
@@ -274,6 +993,7 @@ void ImageDataDealloc(void * info) {
 int ImageGen::GenerateImage(QImage& imageOut, GenSettings& genSet) {
     // This function works in image logical coordinates, which are integers
     int ret = -1;
+    genSet.lastUsed = ++renderCount;
     if (mainWindow->programMode == ProgramMode::waves) {
         ret = GenerateImageWaves(imageOut, genSet);
     }
@@ -284,6 +1004,32 @@ int ImageGen::GenerateImage(QImage& imageOut, GenSettings& genSet) {
     return ret;
 }
 
+/** ****************************************************************************
+ * @brief ImageGen::UpdateColourIndex recalculates the indexed colour map and
+ * mask of genSet if the colour list or mask have changed, and keeps the colour
+ * bars up to date
+ * @param genSet
+ * @return true if the colour index was recalculated
+ */
+bool ImageGen::UpdateColourIndex(GenSettings &genSet) {
+    bool colourIndexChanged = false;
+    if (StageStale(genSet, Stage::colourLut)
+            || genSet.clrIndexed.length() != genSet.clrIndexMax+1
+            || genSet.maskIndexed.length() != genSet.clrIndexMax+1) {
+        colourMap.CalcColourIndex(genSet);
+        colourMap.CalcMaskIndex(genSet);
+        StageBuilt(genSet, Stage::colourLut);
+        colourIndexChanged = true;
+    }
+    // The colour bars are tagged with the version they were drawn for
+    qint32 clrBarsVersion = (qint32)stageVersion[Stage::colourLut];
+    if (clrBarsVersion != mainWindow->colourMapEditor->GetSumClrBars()
+            || colourIndexChanged) {
+        mainWindow->colourMapEditor->DrawColourBars(genSet, clrBarsVersion);
+    }
+    return colourIndexChanged;
+}
+
 /** ****************************************************************************
  * @brief ImageGen::GenerateImageWaves
  */
@@ -291,64 +1037,88 @@ int ImageGen::GenerateImageWaves(QImage &imageOut, GenSettings &genSet) {
     QElapsedTimer fnTimer;
     fnTimer.start();
 
-    QVector<EmitterF> emittersF;
-    if (GetEmitterList(emittersF)) {
-        return -2;
+    // Each stage below is only run if a setting it depends on has been edited
+    // since it was last built for genSet (see Invalidate)
+
+    // EMITTERS
+    if (StageStale(genSet, Stage::emitters)) {
+        QVector<EmitterF> emitters;
+        if (GetEmitterList(emitters)) {
+            return -2;
+        }
+        // Convert emLocs to image coordinates
+        genSet.emittersImg.resize(emitters.size());
+        for (int32_t i = 0; i < emitters.size(); i++) {
+            genSet.emittersImg[i] = EmitterI(emitters[i], genSet.imgPerSimUnit);
+        }
+        StageBuilt(genSet, Stage::emitters);
     }
-    if (emittersF.size() == 0) {
+    const QVector<EmitterI>& emittersImg = genSet.emittersImg;
+    if (emittersImg.size() == 0) {
         qWarning("fillImageData: No emitters! Abort drawing");
         return -1;
     }
-    // Convert emLocs to image coordinates
-    QVector<EmitterI> emittersImg(emittersF.size());
-    for (int32_t i = 0; i < emittersF.size(); i++) {
-        emittersImg[i] = EmitterI(emittersF[i], genSet.imgPerSimUnit);
-    }
 
     //    qDebug() << "Simulation window " << RectFToQString(areaSim) << "[sim units]";
     //    qDebug() << "   Image size " << RectToQString(genSet.areaImg) << "[img units]";
     //    qDebug("imgPerSimUnit = %.2f. numpoints", genSet.imgPerSimUnit);
 
     // TEMPLATES
+    bool templatDistChanged = false;
+    bool templatAmpChanged = false;
+    bool templatePhasorChanged = false;
+    if (StageStale(genSet, Stage::templates)) {
+        // Determine the range of the offset template
+        QRect templateRect(0,0,0,0);
+        for (EmitterI e : emittersImg) {
+            templateRect |= genSet.areaImg.translated(-e.loc);
+            // !@# need to upgrade the use of this template function to avoid crazy big arrays
+        }
+        if (!EnsureMemory(genSet, templateRect)) {
+            QString msg = QString::asprintf("ImageGen: %lld MB memory budget exceeded. Image not generated. Set WAVEPAPER_MEM_BUDGET_MB to raise it",
+                                            memBudgetBytes >> 20);
+            qWarning() << msg;
+            mainWindow->textWindow->appendPlainText(msg);
+            return -3;
+        }
 
-    // Determine the range of the offset template
-    QRect templateRect(0,0,0,0);
-    for (EmitterI e : emittersImg) {
-        templateRect |= genSet.areaImg.translated(-e.loc);
-        // !@# need to upgrade the use of this template function to avoid crazy big arrays
-    }
+        // *************************************************************************
+        // Distance template
+        if (!genSet.templateDist.arr || !genSet.templateDist.arr->rect().contains(templateRect) ||
+                genSet.imgPerSimUnit != genSet.templateDist.imgPerSimUnit) {
+            // Must recalculate distance template
+            CalcDistTemplate(templateRect, genSet);
+            templatDistChanged = true;
+        }
 
-    // *************************************************************************
-    // Distance template
-    bool templatDistChanged = false;
-    if (!genSet.templateDist.arr || !genSet.templateDist.arr->rect().contains(templateRect) ||
-            genSet.imgPerSimUnit != genSet.templateDist.imgPerSimUnit) {
-        // Must recalculate distance template
-        CalcDistTemplate(templateRect, genSet);
-        templatDistChanged = true;
-    }
+        // *************************************************************************
+        // Single emiiter amplitude template
+        qreal distOffset = TemplateDistOffset(genSet);
+        if (templatDistChanged || !genSet.templateAmp.arr ||
+                (genSet.templateAmp.arr->rect() != genSet.templateDist.arr->rect()) ||
+                genSet.templateAmp.distOffset != distOffset) {
+            // Must recalculate amplitude template
+            CalcAmpTemplate(distOffset, genSet);
+            templatAmpChanged = true;
+        }
 
-    // *************************************************************************
-    // Single emiiter amplitude template
-    bool templatAmpChanged = false;
-    qreal distOffset = (qreal)(genSet.areaImg.height() + genSet.areaImg.width()) / 2. * s.distOffsetF / genSet.imgPerSimUnit;
-    if (templatDistChanged || !genSet.templateAmp.arr ||
-            (genSet.templateAmp.arr->rect() != genSet.templateDist.arr->rect()) ||
-            genSet.templateAmp.distOffset != distOffset) {
-        // Must recalculate amplitude template
-        CalcAmpTemplate(distOffset, genSet);
-        templatAmpChanged = true;
-    }
+        // *************************************************************************
+        // Single emitter phasor template
+        if (!genSet.usePhasorTemplate) {
+            // Memory is short. The phasors are calculated from the distance &
+            // amplitude templates while summing
+        }
+        else if (templatAmpChanged || !genSet.templatePhasor.arr ||
+                genSet.imgPerSimUnit != genSet.templatePhasor.imgPerSimUnit ||
+                genSet.templateAmp.distOffset != genSet.templatePhasor.distOffset ||
+                !genSet.templatePhasor.arr->rect().contains(templateRect)) {
+            // The packed template doesn't depend on the wavelength, so this
+            // isn't needed when only the wavelength changes
+            CalcPhasorTemplate(templateRect, genSet);
+            templatePhasorChanged = true;
+        }
 
-    // *************************************************************************
-    // Single emitter phasor template
-    bool templatePhasorChanged = false;
-    if (templatAmpChanged || !genSet.templatePhasor.arr ||
-            genSet.imgPerSimUnit != genSet.templatePhasor.imgPerSimUnit ||
-            s.wavelength != genSet.templatePhasor.wavelength ||
-            !genSet.templatePhasor.arr->rect().contains(templateRect)) {
-        CalcPhasorTemplate(templateRect, genSet);
-        templatePhasorChanged = true;
+        StageBuilt(genSet, Stage::templates);
     }
 
     auto timePostTemplates = fnTimer.elapsed();
@@ -358,109 +1128,105 @@ int ImageGen::GenerateImageWaves(QImage &imageOut, GenSettings &genSet) {
     // Generate a map of the phasors for each emitter, and sum together
     // Use the distance and amplitude templates
 
-    // First, determine if it needs to be recalculated
-    CheckSum sum;
-    sum.Add((void*)&genSet.templateDist, sizeof(genSet.templateDist));
-    sum.Add((void*)&genSet.templateAmp, sizeof(genSet.templateAmp));
-    sum.Add((void*)&genSet.templatePhasor, sizeof(genSet.templatePhasor));
-    sum.Add((void*)emittersImg.data(), sizeof(emittersImg[0]) * emittersImg.length());
+    // Spectral mode sums one wavelength per colour channel. The sums of the
+    // other mode aren't needed
+    const qint32 sumCount = s.spectralMode ? GenSettings::spectralCount : 1;
+    SumArray* sums = s.spectralMode ? genSet.spectralArr : &genSet.combinedArr;
+    if (s.spectralMode) {
+        genSet.combinedArr.Release();
+    }
+    else {
+        for (SumArray& sumArr : genSet.spectralArr) {
+            sumArr.Release();
+        }
+    }
+
     bool phasorSumChanged = false;
-    if (templatePhasorChanged || genSet.combinedArr.phasorArr == nullptr ||
-            genSet.combinedArr.checkSum != sum.Get()) {
-        // Recalculate the phasor sum array
-        if (genSet.combinedArr.phasorArr) {delete genSet.combinedArr.phasorArr;}
-        genSet.combinedArr.phasorArr = new Complex2D_C(genSet.areaImg);
-        genSet.combinedArr.checkSum = sum.Get();
-        for (const EmitterI& e : emittersImg) {
-            AddPhasorArr(e, *genSet.templateDist.arr, *genSet.templateAmp.arr, *genSet.templatePhasor.arr, *genSet.combinedArr.phasorArr);
-        }
-
-        // Calculate amplitudes, min and max values
-        if (genSet.combinedArr.ampArr) {delete genSet.combinedArr.ampArr;}
-        genSet.combinedArr.ampArr = new Double2D_C(genSet.combinedArr.phasorArr->rect());
-        genSet.combinedArr.ampMax = 0;
-        genSet.combinedArr.ampMin = genSet.templateAmp.arr->getPoint(1,1);
-
-        qint32 y0 = genSet.combinedArr.ampArr->yTop;
-        qint32 ye = genSet.combinedArr.ampArr->yTop + genSet.combinedArr.ampArr->height;
-        qint32 x0 = genSet.combinedArr.ampArr->xLeft;
-        qint32 xe = genSet.combinedArr.ampArr->xLeft + genSet.combinedArr.ampArr->width;
-        for (qint32 y = y0; y < ye; y++) {
-            for (int x = x0; x < xe; x++) {
-                qreal amp = std::abs(genSet.combinedArr.phasorArr->getPoint(x, y));
-                genSet.combinedArr.ampArr->setPoint(x, y, amp);
-                genSet.combinedArr.ampMin = std::min(genSet.combinedArr.ampMin, amp);
-                genSet.combinedArr.ampMax = std::max(genSet.combinedArr.ampMax, amp);
-            }
+    if (templatePhasorChanged || sums[0].phasorArr == nullptr ||
+            StageStale(genSet, Stage::sum)) {
+        // Recalculate the phasor sum arrays
+        qreal wavelengths[GenSettings::spectralCount];
+        for (qint32 c = 0; c < sumCount; c++) {
+            sums[c].Release();
+            sums[c].phasorArr = new Complex2D_C(genSet.areaImg);
+            wavelengths[c] = s.spectralMode ? SpectralWavelength(s.wavelength, c) : s.wavelength;
         }
+        SumPhasors(emittersImg, genSet, wavelengths, sums, sumCount);
+        StageBuilt(genSet, Stage::sum);
         phasorSumChanged = true;
     }
 
+    // NORMALISE
+    if (phasorSumChanged || sums[0].ampArr == nullptr ||
+            StageStale(genSet, Stage::normalise)) {
+        // Calculate the displayed values, min and max
+        FieldMode mode = CurrentFieldMode();
+        FastTrig::Phase timePhase = FastTrig::TurnsToPhase(animTurns);
+        for (qint32 c = 0; c < sumCount; c++) {
+            CalcFieldValues(sums[c], genSet.templateAmp.arr->getPoint(1,1), mode, timePhase);
+        }
+        StageBuilt(genSet, Stage::normalise);
+    }
+
     auto timePostPhasors = fnTimer.elapsed();
-    bool colourIndexChanged = false;
 
     // COLOUR MAP
-    // Use simple checksums to determine when data changes
-    CheckSum sumClrList((void*)s.clrList.data(), sizeof(s.clrList[0]) * s.clrList.length());
-    CheckSum sumMask((void*)&s.maskCfg, sizeof(s.maskCfg));
-    if (sumClrList != genSet.clrListCheckSum
-            || genSet.clrIndexed.length() != genSet.clrIndexMax+1
-            || sumMask != genSet.maskCheckSum
-            || genSet.maskIndexed.length() != genSet.clrIndexMax+1) {
-        colourMap.CalcColourIndex(genSet);
-        genSet.clrListCheckSum = sumClrList;
-
-        colourMap.CalcMaskIndex(genSet);
-        genSet.maskCheckSum = sumMask;
-
-        colourIndexChanged = true;
-    }
-    qint32 sumClrBars = sumClrList.Get() + sumMask.Get();
-    if (sumClrBars != mainWindow->colourMapEditor->GetSumClrBars()
-            || colourIndexChanged) {
-        mainWindow->colourMapEditor->DrawColourBars(genSet, sumClrBars);
-    }
+    bool colourIndexChanged = UpdateColourIndex(genSet);
 
     auto timePostColourIndices = fnTimer.elapsed();
 
     // CREATE PIXEL ARRAY
     // (apply colour map to phasor sum array)
-    // (It's assumed this is always necessary. Otherwise we shouldn't recalculating here)
-    Rgb2D_C* pixArr = new Rgb2D_C(genSet.areaImg);
-    qreal maxAmp = genSet.combinedArr.ampMax;
-    qreal minAmp = genSet.combinedArr.ampMin;
-    qreal mult = 1. / (maxAmp - minAmp);
-    for (int y = pixArr->yTop; y < pixArr->yTop + pixArr->height; y++) {
-        for (int x = pixArr->xLeft; x < pixArr->xLeft + pixArr->width; x++) {
-            // Calculate location in range 0 to 1;
-            qreal loc = (genSet.combinedArr.ampArr->getPoint(x, y) - minAmp) * mult;
-            if (genSet.indexedClr) {
-                pixArr->setPoint(x, y, colourMap.GetColourValueIndexed(genSet, loc)); // Faster
-            }
-            else {
-                pixArr->setPoint(x, y, colourMap.GetColourValue(genSet, loc));
+    // (This is always necessary, as each frame is rendered into a different buffer)
+    // The pixel allocation of imageOut is reused if it's the right size
+    if (imageOut.size() != genSet.areaImg.size() || imageOut.format() != QImage::Format_ARGB32) {
+        Rgb2D_C* pixArr = new Rgb2D_C(genSet.areaImg);
+        imageOut = QImage((uchar*)pixArr->getDataPtr(), pixArr->width, pixArr->height,
+                          pixArr->stride * (int)sizeof(QRgb), QImage::Format_ARGB32, &ImageDataDealloc, pixArr);
+        // QRgb is ARGB32 (8 bits per channel)
+    }
+    if (s.spectralMode) {
+        ColourSpectral(genSet.spectralArr, imageOut);
+    }
+    else {
+        const Double2D_C& ampArr = *genSet.combinedArr.ampArr;
+        qreal maxAmp = genSet.combinedArr.ampMax;
+        qreal minAmp = genSet.combinedArr.ampMin;
+        qreal mult = 1. / (maxAmp - minAmp);
+        for (int y = 0; y < imageOut.height(); y++) {
+            QRgb* pixLine = (QRgb*)imageOut.scanLine(y);
+            for (int x = 0; x < imageOut.width(); x++) {
+                // Calculate location in range 0 to 1;
+                qreal loc = (ampArr.getPoint(x + ampArr.xLeft, y + ampArr.yTop) - minAmp) * mult;
+                if (genSet.indexedClr) {
+                    pixLine[x] = colourMap.GetColourValueIndexed(genSet, loc); // Faster
+                }
+                else {
+                    pixLine[x] = colourMap.GetColourValue(genSet, loc);
+                }
             }
         }
     }
 
+    StageBuilt(genSet, Stage::colouring);
     auto timePostPixArr = fnTimer.elapsed();
 
-    imageOut = QImage((uchar*)pixArr->getDataPtr(), pixArr->width, pixArr->height, QImage::Format_ARGB32,
-                      &ImageDataDealloc, pixArr);
-    // QRgb is ARGB32 (8 bits per channel)
-
     auto timePostImage = fnTimer.elapsed();
+    genSet.lastFrameMs = timePostImage;
+    genSet.lastOneOffMs = timePostTemplates + (timePostColourIndices - timePostPhasors);
 
     QString imgGenTime = \
-            QString::asprintf("ImageGen%s %dx%dpx %4lld ms. Templates=%4lldms (%d,%d,%d), PhasorMap=%4lldms (%d), ClrIdx=%4lldms(%d), Colouring=%4lldms, Image=%4lldms",
+            QString::asprintf("ImageGen%s %dx%dpx %4lld ms. Templates=%4lldms (%d,%d,%d), PhasorMap=%4lldms (%d), ClrIdx=%4lldms(%d), Colouring=%4lldms, Image=%4lldms, Mem=%lld/%lldMB%s",
                               &genSet == &genQuick ? "Quick" : "",
-                              pixArr->width, pixArr->height,
+                              imageOut.width(), imageOut.height(),
                               fnTimer.elapsed(), timePostTemplates,
                               templatDistChanged, templatAmpChanged, templatePhasorChanged,
                               timePostPhasors - timePostTemplates, phasorSumChanged,
                               timePostColourIndices - timePostPhasors, colourIndexChanged,
                               timePostPixArr - timePostColourIndices,
-                              timePostImage - timePostPixArr);
+                              timePostImage - timePostPixArr,
+                              (OtherCacheBytes(genSet) + genSet.CacheBytes()) >> 20, memBudgetBytes >> 20,
+                              genSet.usePhasorTemplate ? (genSet.templateOversize ? "" : " (no oversize)") : " (no phasor template)");
     qDebug() << imgGenTime;
 
 
@@ -469,6 +1235,22 @@ int ImageGen::GenerateImageWaves(QImage &imageOut, GenSettings &genSet) {
 }
 
 
+/** ****************************************************************************
+ * @brief CopyRaster copies a raster to the output, reusing the output's
+ * allocation where possible
+ * @param raster
+ * @param imageOut
+ */
+static void CopyRaster(const QImage &raster, QImage &imageOut) {
+    if (imageOut.size() == raster.size() && imageOut.format() == raster.format()
+            && imageOut.bytesPerLine() == raster.bytesPerLine()) {
+        memcpy(imageOut.bits(), raster.constBits(), (size_t)raster.bytesPerLine() * raster.height());
+    }
+    else {
+        imageOut = raster.copy();
+    }
+}
+
 /** ****************************************************************************
  * @brief ImageGen::GenerateImageFourBar
  */
@@ -478,85 +1260,149 @@ int ImageGen::GenerateImageFourBar(QImage &imageOut, GenSettings &genSet) {
     QElapsedTimer fnTimer;
     fnTimer.start();
 
-    imageOut = QImage(genSet.areaImg.width(), genSet.areaImg.height(), QImage::Format_ARGB32);
-    //imageOut = QImage(500, 500, QImage::Format_ARGB32);
-
-    // Equations:
-    // ta2 = 2*atan(((2*la2^2*(xa - xb + la1*cos(ta1) - lb1*cos(tb1))^2 - (xa - xb + la1*cos(ta1) - lb1*cos(tb1))^4 - (ya - yb + la1*sin(ta1) - lb1*sin(tb1))^4 - 2*(ya - yb + la1*sin(ta1) - lb1*sin(tb1))^2*(xa - xb + la1*cos(ta1) - lb1*cos(tb1))^2 + 2*lb2^2*(xa - xb + la1*cos(ta1) - lb1*cos(tb1))^2 + 2*la2^2*(ya - yb + la1*sin(ta1) - lb1*sin(tb1))^2 + 2*lb2^2*(ya - yb + la1*sin(ta1) - lb1*sin(tb1))^2 - la2^4 - lb2^4 + 2*la2^2*lb2^2)^(1/2) - 2*la2*(ya - yb + la1*sin(ta1) - lb1*sin(tb1)))/((xa - xb + la1*cos(ta1) - lb1*cos(tb1))^2 + (ya - yb + la1*sin(ta1) - lb1*sin(tb1))^2 - 2*la2*(xa - xb + la1*cos(ta1) - lb1*cos(tb1)) + la2^2 - lb2^2))
-    // Simplified to:
-    // ka = xa - xb + la1*cos(ta1) - lb1*cos(tb1)
-    // kb = ya - yb + la1*sin(ta1) - lb1*sin(tb1)
-    // kc = ka^2 + kb^2 - lb2^2
-    // ta2 = 2*atan((((2*la2*lb2)^2 - (kc - la2^2)^2)^(1/2) - 2*la2*kb)/(kc - 2*la2*ka + la2^2))
-
     auto& fb = s.fourBar;
-    qreal imgCoordScaler = 0.001 * (imageOut.width() + imageOut.height()); // Scales according to the output size
-
-    qreal lenScaler = imgCoordScaler * fb.lenBase;
-    qreal xa_ = lenScaler * -fb.baseSepX + imageOut.width()/2;;
-    qreal xb_ = lenScaler * fb.baseSepX + imageOut.width()/2;
-    qreal ya_ = lenScaler * (-2 + fb.baseOffsetY) + imageOut.height()*0.6;
-    qreal yb_ = lenScaler * (-2 - fb.baseOffsetY) + imageOut.height()*0.6;
+    QSize imgSize = genSet.areaImg.size();
+
+    if (!fb.densityMode && !StageStale(genSet, Stage::fourBarGeom) && genSet.fourBarRaster.size() == imgSize) {
+        // Nothing that affects the drawing has been edited since the raster was drawn
+        CopyRaster(genSet.fourBarRaster, imageOut);
+        genSet.lastFrameMs = fnTimer.elapsed();
+        genSet.lastOneOffMs = 0;
+        return 0;
+    }
 
-    qreal la1_ = lenScaler;
-    qreal lb1_ = lenScaler * fb.lenRatioB;
-    qreal la2_ = lenScaler * fb.lenRatio2;
-    qreal lb2_ = lenScaler * fb.lenRatioB * fb.lenRatio2;
+    qint32 stepCount = FourBar::StepCount(fb, genSet.pointsPerRev); // Capped at one period of the path
+    FourBar::PathTransform tf = FourBar::MakeTransform(fb, imgSize);
+
+    // Geometry stage. The geometry is shared by the quick & preview images, and
+    // its tolerance is set by the preview, so an upgrade only re-rasterises.
+    // Other settings (saves) use their own geometry & tolerance, like SaveImageFourBarTiled
+    bool interactive = &genSet == &genPreview || &genSet == &genQuick;
+    FourBar::Geometry localGeom;
+    FourBar::Geometry& geometry = interactive ? fourBarGeom : localGeom;
+    qreal tolerance = interactive
+            ? FourBar::GeometryTolerance(genPreview.chordTolerance,
+                                         FourBar::MakeTransform(fb, genPreview.areaImg.size()).scale)
+            : FourBar::GeometryTolerance(genSet.chordTolerance, tf.scale);
+    bool geomChanged = FourBar::UpdateGeometry(fb, genSet.pointsPerRev, tolerance, stepCount, geometry);
+    const FourBarPath& path = geometry.path;
+    qint32 pointCount = path.PointsUpTo(stepCount - 1);
+    qint64 pathMs = fnTimer.elapsed();
+
+    if (fb.densityMode) {
+        FourBar::SplatDensity(path, pointCount, tf, imgSize, genSet.fourBarDensity);
+        qint64 splatMs = fnTimer.elapsed() - pathMs;
+
+        bool colourIndexChanged = UpdateColourIndex(genSet);
+        qint64 clrIdxMs = fnTimer.elapsed() - splatMs - pathMs;
+        ToneMapDensity(genSet.fourBarDensity.density, imageOut, genSet);
+
+        genSet.lastFrameMs = fnTimer.elapsed();
+        genSet.lastOneOffMs = colourIndexChanged ? clrIdxMs : 0;
+
+        QString imgGenTime = \
+                QString::asprintf("ImageGen density %4lld ms (path %lld ms%s, splat %lld ms). (%dx%d)",
+                                  fnTimer.elapsed(), pathMs, geomChanged ? "" : " cached", splatMs,
+                                  imageOut.width(), imageOut.height());
+        qDebug() << imgGenTime;
+        mainWindow->textWindow->appendPlainText(imgGenTime);
+        return 0;
+    }
 
-    qreal ta1_ = fb.ta1Init;
-    qreal tb1_ = ta1_ + fb.initAngleOffset;
-    qint32 stepCount = fb.revCount * genSet.pointsPerRev;
+    // Rasterisation stage
+    // If only revCount has grown since the last image, just the new segments are drawn
+    QImage& raster = genSet.fourBarRaster;
+    bool extend = interactive
+            && raster.size() == imgSize
+            && genSet.fourBarRasterGeomSerial == geometry.serial
+            && genSet.fourBarRasterCfg.SameExceptRevCount(fb)
+            && stepCount >= genSet.fourBarRasterSteps;
+    qint32 pointFirst = extend ? path.PointsUpTo(genSet.fourBarRasterSteps - 1) : 0;
+    if (!extend) {
+        if (raster.size() != imgSize || raster.format() != QImage::Format_ARGB32) {
+            raster = QImage(imgSize, QImage::Format_ARGB32);
+        }
+        raster.fill(Qt::black);
+    }
 
-    qreal inca = (1. / (1. + fb.revRatioB)) / genSet.pointsPerRev * 2. * PI;
-    qreal incb = (fb.revRatioB / (1. + fb.revRatioB)) / genSet.pointsPerRev * 2. * PI;
+    FourBar::StrokeStyle style = FourBar::MakeStrokeStyle(fb, imgSize, genSet.pointsPerRev);
+    RasterTarget target = RasterTarget::FromImage(raster);
+    for (qint32 step = qMax(1, pointFirst); step < pointCount; step++) {
+        FourBar::DrawSegment(path, tf, style, target, step);
+    }
+    genSet.fourBarRasterCfg = fb;
+    genSet.fourBarRasterGeomSerial = geometry.serial;
+    genSet.fourBarRasterSteps = stepCount;
+    StageBuilt(genSet, Stage::fourBarGeom);
 
-    qreal widthVariable = fb.lineWidth * imgCoordScaler * fb.lineTaperRatio;
-    qreal widthFixed = fb.lineWidth * imgCoordScaler * (1.0 - fb.lineTaperRatio);
+    CopyRaster(raster, imageOut);
 
-    QPainter imgPainter(&imageOut);
-    QPen imgPen = QPen(QColor(Qt::white), fb.lineWidth, Qt::SolidLine,
-                       Qt::RoundCap, Qt::RoundJoin);
-    imgPainter.setRenderHint(QPainter::Antialiasing);
+    genSet.lastFrameMs = fnTimer.elapsed();
+    genSet.lastOneOffMs = 0;
 
-    imgPainter.setPen(imgPen);
-    imgPainter.setBackground(QBrush(Qt::black));
-    imgPainter.setBrush(QBrush(Qt::black));
-    imgPainter.fillRect(imageOut.rect(), Qt::black);
+    QString imgGenTime = \
+            QString::asprintf("ImageGen %4lld ms (path %lld ms%s, %d points, from point %d). (%dx%d)",
+                              fnTimer.elapsed(), pathMs, geomChanged ? "" : " cached", pointCount, pointFirst,
+                              imageOut.width(), imageOut.height());
+    qDebug() << imgGenTime;
+    mainWindow->textWindow->appendPlainText(imgGenTime);
+    return 0;
+}
 
-    QPointF prevPoint;
-    for (qint32 step = 0; step < stepCount; step++) {
-        qreal xa2_ = xa_ + + la1_*cosQuick(ta1_);
-        qreal ya2_ = ya_ + la1_*sinQuick(ta1_);
-        qreal ka_ = xa2_ - xb_ - lb1_*cosQuick(tb1_);
-        qreal kb_ = ya2_ - yb_ - lb1_*sinQuick(tb1_);
-        qreal kc_ = ka_*ka_ + kb_*kb_ - lb2_*lb2_;
-        qreal kd_ = 2*la2_*lb2_;
-        qreal ke_ = kc_ - la2_*la2_;
-        qreal ta2_ = 2* atan2((sqrt(kd_*kd_ - ke_*ke_) - 2*la2_*kb_),(kc_ - 2*la2_*ka_ + la2_*la2_));
 
-        qreal x3_ = xa2_ + la2_*cosQuick(ta2_);
-        qreal y3_ = ya2_ + la2_*sinQuick(ta2_);
+/** ****************************************************************************
+ * @brief ImageGen::ToneMapDensity colours a density buffer through the colour
+ * map. A log curve maps the density to 0 (empty) to 1.0 (the densest pixel), so
+ * that detail remains visible in both sparse & saturated areas.
+ * @param density has one value per pixel, row by row
+ * @param imageOut is resized if required
+ * @param genSet
+ */
+void ImageGen::ToneMapDensity(const QVector<float> &density, QImage &imageOut, GenSettings &genSet) {
+    QSize imgSize = genSet.areaImg.size();
+    if (imageOut.size() != imgSize || imageOut.format() != QImage::Format_ARGB32) {
+        imageOut = QImage(imgSize, QImage::Format_ARGB32);
+    }
+    float maxDensity = 0;
+    for (float d : density) {
+        maxDensity = qMax(maxDensity, d);
+    }
+    qreal mult = DensityToneScale(maxDensity);
+    for (int y = 0; y < imageOut.height(); y++) {
+        ToneMapDensityRow(density.constData() + y * imgSize.width(), imgSize.width(), mult,
+                          (QRgb*)imageOut.scanLine(y), genSet);
+    }
+}
 
-        QPointF thisPoint(x3_, y3_);
-        if (step != 0) {
-            QLineF thisLine(prevPoint, thisPoint);
-            imgPen.setWidthF(widthFixed + widthVariable / qMax(1., thisLine.length() * genSet.pointsPerRev * 0.002));
+/** ****************************************************************************
+ * @brief ImageGen::DensityToneScale
+ * @param maxDensity is the peak density of the whole image
+ * @return the scale for ToneMapDensityRow, which maps the peak to the end of
+ * the colour map
+ */
+qreal ImageGen::DensityToneScale(float maxDensity) {
+    return maxDensity > 0 ? 1. / log1p(maxDensity) : 0.;
+}
 
-            imgPainter.setPen(imgPen);
-            imgPainter.drawLine(prevPoint, thisPoint);
+/** ****************************************************************************
+ * @brief ImageGen::ToneMapDensityRow colours one row of a density image
+ * @param density
+ * @param width
+ * @param mult is from DensityToneScale
+ * @param pixLine is the output row
+ * @param genSet
+ */
+void ImageGen::ToneMapDensityRow(const float *density, qint32 width, qreal mult, QRgb *pixLine,
+                                 GenSettings &genSet) {
+    for (qint32 x = 0; x < width; x++) {
+        qreal loc = log1p(density[x]) * mult;
+        if (genSet.indexedClr) {
+            pixLine[x] = colourMap.GetColourValueIndexed(genSet, loc); // Faster
+        }
+        else {
+            pixLine[x] = colourMap.GetColourValue(genSet, loc);
         }
-        prevPoint = thisPoint;
-
-        // Increment angles
-        ta1_ = ta1_ + inca;
-        tb1_ = tb1_ + incb;
     }
-
-    QString imgGenTime = \
-            QString::asprintf("ImageGen %4lld ms. (%dx%d)", fnTimer.elapsed(), imageOut.width(), imageOut.height());
-    qDebug() << imgGenTime;
-    mainWindow->textWindow->appendPlainText(imgGenTime);
-    return 0;
 }
 
 
@@ -568,7 +1414,7 @@ int ImageGen::GenerateImageFourBar(QImage &imageOut, GenSettings &genSet) {
 void ImageGen::CalcDistTemplate(QRect templateRect, GenSettings & genSet) {
     // Make the template size 20% bigger (to prevent very frequent calculation)
     QPoint center = templateRect.center();
-    templateRect.setSize(templateRect.size() * templateOversizeFactor);
+    templateRect.setSize(templateRect.size() * (genSet.templateOversize ? templateOversizeFactor : 1.));
     templateRect.moveCenter(center);
     qDebug() << "Recalculating dist template for range " << RectToQString(templateRect);
 
@@ -603,7 +1449,7 @@ void ImageGen::CalcAmpTemplate(qreal distOffset, GenSettings & genSet) {
 void ImageGen::CalcPhasorTemplate(QRect templateRect, GenSettings & genSet) {
     // Make the template size 20% bigger (to prevent very frequent calculation)
     QPoint center = templateRect.center();
-    templateRect.setSize(templateRect.size() * templateOversizeFactor);
+    templateRect.setSize(templateRect.size() * (genSet.templateOversize ? templateOversizeFactor : 1.));
     templateRect.moveCenter(center);
     // Prevent the phasor template from being larger than the distance and amplitude
     if (!genSet.templateDist.arr->rect().contains(templateRect)) {
@@ -612,11 +1458,146 @@ void ImageGen::CalcPhasorTemplate(QRect templateRect, GenSettings & genSet) {
 
     qDebug() << "Recalculating phasor template for range " << RectToQString(templateRect);
     // Template array of phasors
-    genSet.templatePhasor.MakeNew(templateRect, s.wavelength, genSet.imgPerSimUnit);
+    genSet.templatePhasor.MakeNew(templateRect, genSet.imgPerSimUnit, genSet.templateAmp.distOffset);
     CalcPhasorArr(genSet.templatePhasor, *genSet.templateDist.arr, *genSet.templateAmp.arr);
 }
 
 
+/** ****************************************************************************
+ * @brief ImageGen::TemplateDistOffset
+ * @return the distance offset ('a' in the amplitude equation 1/(r+a)) for the
+ * current settings, in simulation units
+ */
+qreal ImageGen::TemplateDistOffset(const GenSettings & genSet) const {
+    return (qreal)(genSet.areaImg.height() + genSet.areaImg.width()) / 2. * s.distOffsetF / genSet.imgPerSimUnit;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::PrefetchForDrag is called when a drag starts. It predicts
+ * which templates the drag will need, and builds them in idle time (before the
+ * first drag frames need them)
+ * @param interactType
+ */
+void ImageGen::PrefetchForDrag(Interact::Type interactType) {
+    if (mainWindow->programMode != ProgramMode::waves) {
+        return;
+    }
+    switch (interactType) {
+    case Interact::Type::arrangement:
+    case Interact::Type::arrangement2:
+    case Interact::Type::location:
+        // Emitters will move. The template grows as emitters spread out
+        prefetchTemplateArea = true;
+        scheduler.RequestIdleWork();
+        break;
+    default:
+        break;
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::RunPrefetch performs the requested prefetching. It's called
+ * by the scheduler when no quick frame is due.
+ * Only the quick templates are prefetched, as they're used during drags.
+ */
+void ImageGen::RunPrefetch() {
+    if (mainWindow->programMode != ProgramMode::waves) {
+        prefetchTemplateArea = false;
+        return;
+    }
+    if (prefetchTemplateArea && !prefetchWatcher.isRunning()) {
+        // If templates are still being built, the request is kept until they're installed
+        prefetchTemplateArea = false;
+        PrefetchTemplateArea(genQuick);
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::PrefetchTemplateArea grows the templates such that they
+ * cover an emitter anywhere within the view area. The templates are built in
+ * the background, and installed by InstallPrefetchedTemplates
+ * @param genSet
+ */
+void ImageGen::PrefetchTemplateArea(GenSettings & genSet) {
+    if (!genSet.templateOversize || !genSet.usePhasorTemplate) {
+        return; // Memory is short
+    }
+    const QRect& a = genSet.areaImg;
+    // The offsets from any point in the view to any other point in the view
+    QRect predictedRect(a.left() - a.right(), a.top() - a.bottom(), 2 * a.width() - 1, 2 * a.height() - 1);
+    if (genSet.templateDist.arr && genSet.templateDist.imgPerSimUnit == genSet.imgPerSimUnit) {
+        if (genSet.templatePhasor.arr && genSet.templatePhasor.arr->rect().contains(predictedRect)) {
+            return; // Already big enough
+        }
+        predictedRect |= genSet.templateDist.arr->rect();
+    }
+    // Make the template size 20% bigger (to prevent very frequent calculation)
+    QPoint center = predictedRect.center();
+    predictedRect.setSize(predictedRect.size() * templateOversizeFactor);
+    predictedRect.moveCenter(center);
+    // The current templates are kept until the new ones are installed
+    qint64 bytesPerTemplatePoint = 2 * sizeof(double) + sizeof(PackedPhasor);
+    qint64 templateBytes = (qint64)predictedRect.width() * predictedRect.height() * bytesPerTemplatePoint;
+    if (OtherCacheBytes(genSet) + genSet.CacheBytes() + templateBytes > memBudgetBytes) {
+        return;
+    }
+    qDebug() << "Prefetching templates for range " << RectToQString(predictedRect);
+    prefetchWatcher.setFuture(QtConcurrent::run(&ImageGen::BuildTemplates, predictedRect,
+                                                genSet.imgPerSimUnit, TemplateDistOffset(genSet)));
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::BuildTemplates builds a new set of templates. It runs in a
+ * worker thread, so it mustn't touch any GenSettings
+ * @param templateRect is the template size (no oversize is added)
+ * @param imgPerSimUnit
+ * @param distOffset is the value 'a' in the amplitude equation: 1/(r+a)
+ * @return the templates. The caller takes ownership
+ */
+ImageGen::PrefetchedTemplates* ImageGen::BuildTemplates(QRect templateRect, qreal imgPerSimUnit, qreal distOffset) {
+    PrefetchedTemplates* t = new PrefetchedTemplates;
+    t->dist.arr = new Double2D_C(templateRect);
+    CalcDistArr(1. / imgPerSimUnit, *t->dist.arr);
+    t->dist.imgPerSimUnit = imgPerSimUnit;
+    t->amp.arr = new Double2D_C(templateRect);
+    CalcAmpArr(distOffset, *t->dist.arr, *t->amp.arr);
+    t->amp.distOffset = distOffset;
+    t->phasor.MakeNew(templateRect, imgPerSimUnit, distOffset);
+    CalcPhasorArr(t->phasor, *t->dist.arr, *t->amp.arr);
+    return t;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::InstallPrefetchedTemplates swaps the prefetched templates
+ * into the quick settings. They're discarded if the settings changed while
+ * they were built, or if the templates have since grown past them.
+ * The template values don't depend on the template size, so nothing is
+ * invalidated.
+ */
+void ImageGen::InstallPrefetchedTemplates() {
+    PrefetchedTemplates* t = prefetchWatcher.result();
+    GenSettings& genSet = genQuick;
+    bool current = genSet.templateOversize && genSet.usePhasorTemplate &&
+            t->dist.imgPerSimUnit == genSet.imgPerSimUnit &&
+            t->amp.distOffset == TemplateDistOffset(genSet);
+    bool larger = !genSet.templatePhasor.arr || !genSet.templatePhasor.arr->rect().contains(t->phasor.arr->rect());
+    if (current && larger) {
+        std::swap(genSet.templateDist, t->dist);
+        std::swap(genSet.templateAmp, t->amp);
+        std::swap(genSet.templatePhasor, t->phasor);
+    }
+    // Whichever templates weren't installed are freed
+    delete t->dist.arr;
+    delete t->amp.arr;
+    delete t->phasor.arr;
+    delete t;
+
+    if (prefetchTemplateArea) {
+        // A prefetch was requested while building
+        scheduler.RequestIdleWork();
+    }
+}
+
 /** ****************************************************************************
  * @brief ImageGen::GetActiveArrangement
  * @return
@@ -676,15 +1657,15 @@ void ImageGen::CalcAmpArr(double distOffset, const Double2D_C & distArr, Double2
 }
 
 /** ****************************************************************************
- * @brief ImageGen::CalcPhasorArr calculates a phasor template over the same
- * range as the distance and amplitude templates
+ * @brief ImageGen::CalcPhasorArr calculates a (packed) phasor template over
+ * the same range as the distance and amplitude templates
  * @param templatePhasor
  * @param templateDist
  * @param templateAmp
  */
 void ImageGen::CalcPhasorArr(TemplatePhasor& templatePhasor,
                              const Double2D_C & templateDist, const Double2D_C & templateAmp) {
-    Complex2D_C& arr = *templatePhasor.arr; // Output phasor array
+    Packed2D_C& arr = *templatePhasor.arr; // Output phasor array
     // Checks
     if (!templateDist.rect().contains(arr.rect())) {
         qFatal("CalcPhasorArr templateDist != templatePhasor! (not supported, but it could be)");
@@ -695,40 +1676,52 @@ void ImageGen::CalcPhasorArr(TemplatePhasor& templatePhasor,
         return;
     }
 
-    // templateDist is in image units (pixels)
-    double radPerSim = -2 * PI / templatePhasor.wavelength; // Radians per unit distance, * -1
-
+    // templateDist is in simulation units
+    double distPerSim = templatePhasor.imgPerSimUnit * PackedPhasor::distPerPix;
+    const int32_t x0 = arr.xLeft;
+    const int32_t xe = arr.xLeft + arr.width;
     for (int32_t y = arr.yTop; y < arr.yTop + arr.height; y++) {
-        for (int32_t x = arr.xLeft; x < arr.xLeft + arr.width; x++) {
-            arr.setPoint(x, y, std::polar<fpComplex>(templateAmp.getPoint(x,y),
-                                                          (templateDist.getPoint(x, y)) * radPerSim));
-            //            fpComplex amp = templateAmp.getPoint(x,y);
-            //            qreal angle = (templateDist.getPoint(x, y) + distOffsetImg) * radPerImg;
-            //            phasorArr.addPoint(x, y, complex(amp * cos(angle), amp * sin(angle)));
+        const double* distRow = templateDist.row(y);
+        const double* ampRow = templateAmp.row(y);
+        PackedPhasor* outRow = arr.row(y);
+        for (int32_t x = x0; x < xe; x++) {
+            outRow[x].dist = (quint32)(distRow[x] * distPerSim + 0.5);
+            outRow[x].amp = (float)ampRow[x];
         }
     }
     return;
 }
 
+/** ****************************************************************************
+ * @brief ImageGen::PackedPhaseStep
+ * @param wavelength (sim units)
+ * @param imgPerSimUnit of the packed template
+ * @return the phase per unit of PackedPhasor::dist, for AddPhasorArr. It's
+ * fixed point with 16 fractional bits. The phase lags with distance, so the
+ * step is negative (modulo 2^64)
+ */
+quint64 ImageGen::PackedPhaseStep(double wavelength, double imgPerSimUnit) {
+    double step = FastTrig::phasePerTurn * 65536. / (wavelength * imgPerSimUnit * PackedPhasor::distPerPix);
+    return (quint64)-(qint64)std::llround(step);
+}
+
 /** ****************************************************************************
  * @brief ImageGen::AddPhasorArr for 1 emitter, calculates the phasor at every
  * location in the view window and add it to phasorArr
  * @param wavelength (sim units)
- * @param distOffset causes a constant phase shift on every point
- * @param templateDist contains pre-calculated distance values for a given offset
+ * @param e is the emitter, in image coordinates. Its distOffset causes a
+ * constant phase shift on every point, and its amplitude scales every point
+ * @param templateDist contains pre-calculated distance values for a given offset (sim units)
  * @param templateAmp contains pre-calculated amplitude values for a given offset
- * @param emLoc is the emitter location that this phasor array is calculated for
- * @param phasorArr is the output array. It also defines the view window
- */
-void ImageGen::AddPhasorArr(double imgPerSimUnit, double wavelength, EmitterI e,
-                             const Double2D_C & templateDist, const Double2D_C & templateAmp,
-                            Complex2D_C & phasorArr) {
-    // phasorArray dimensions are that of the image. emLoc is the location we're calculating for
-    // This function is performed in a shifted coordinate system (for efficiency)
-    // The new coordinate system is 1:1 scale, but has the origin shifted such that the emitter is @ (0,0)
-    QRect rect = phasorArr.rect().translated(-e.loc); // image rect with emitter location is the center
-    // Distort the phasorArr coordinates during this function, such that the emitter is at the center
-    phasorArr.translate(-e.loc);
+ * @param phasorArr is the output. It also defines the area to calculate
+ */
+void ImageGen::AddPhasorArr(double wavelength, EmitterI e,
+                            Double2DConstView_C templateDist, Double2DConstView_C templateAmp,
+                            Complex2DView_C phasorArr) {
+    // The templates are indexed by the offset from the emitter. Moving their
+    // origin to the emitter location lines them up with phasorArr
+    templateDist = templateDist.translated(e.loc);
+    templateAmp = templateAmp.translated(e.loc);
 
     // Checks
     if (!templateDist.rect().contains(phasorArr.rect())) {
@@ -740,61 +1733,327 @@ void ImageGen::AddPhasorArr(double imgPerSimUnit, double wavelength, EmitterI e,
         return;
     }
 
-    // templateDist is in image units (pixels)
-    qreal distOffsetImg = e.distOffset * imgPerSimUnit;
-    double radPerImg = -2 * PI / (wavelength * imgPerSimUnit); // Radians per unit distance, * -1
-    for (int32_t y = rect.top(); y < rect.top() + rect.height(); y++) {
-        for (int32_t x = rect.x(); x < rect.x() + rect.width(); x++) {
-            phasorArr.addPoint(x, y,std::polar<fpComplex>(templateAmp.getPoint(x,y),
-                                                          (templateDist.getPoint(x, y) + distOffsetImg) * radPerImg));
-//            fpComplex amp = templateAmp.getPoint(x,y);
-//            qreal angle = (templateDist.getPoint(x, y) + distOffsetImg) * radPerImg;
-//            phasorArr.addPoint(x, y, complex(amp * cos(angle), amp * sin(angle)));
+    double phasePerSim = -FastTrig::phasePerTurn / wavelength; // Phase per unit distance, * -1
+    const int32_t x0 = phasorArr.xLeft;
+    const int32_t xe = phasorArr.xLeft + phasorArr.width;
+    for (int32_t y = phasorArr.yTop; y < phasorArr.yTop + phasorArr.height; y++) {
+        const double* distRow = templateDist.row(y);
+        const double* ampRow = templateAmp.row(y);
+        complex* outRow = phasorArr.row(y);
+        for (int32_t x = x0; x < xe; x++) {
+            FastTrig::Phase phase = (FastTrig::Phase)(qint64)((distRow[x] + e.distOffset) * phasePerSim);
+            double amp = ampRow[x] * e.amplitude;
+            outRow[x] += complex(amp * FastTrig::Cos(phase), amp * FastTrig::Sin(phase));
         }
     }
-    // Restore the phasorArr coordinates
-    phasorArr.translate(e.loc);
     return;
 }
 
-void ImageGen::AddPhasorArr(const EmitterI& e, const Double2D_C & templateDist,
-                            const Double2D_C & templateAmp, const Complex2D_C & templatePhasor,
-                            Complex2D_C & phasorArr) {
-    // phasorArray dimensions are that of the image. emLoc is the location we're calculating for
-    // This function is performed in a shifted coordinate system (for efficiency)
-    // The new coordinate system is 1:1 scale, but has the origin shifted such that the emitter is @ (0,0)
-    QRect rect = phasorArr.rect().translated(-e.loc); // image rect with emitter location is the center
-    // Distort the phasorArr coordinates during this function, such that the emitter is at the center
-    phasorArr.translate(-e.loc);
+/** ****************************************************************************
+ * @brief ImageGen::AddPhasorArr for 1 emitter, adds the phasor template
+ * (centred on the emitter) to phasorArr, multiplied by the emitter's complex
+ * weight.
+ * The phase of each point is its packed distance times phaseStep. The product
+ * wraps modulo 2^64, and the phase is taken from bits 16 to 47, so the result
+ * is exact to a revolution for any distance.
+ * The weight is applied as a phase offset & an amplitude scale, which costs
+ * an add & a multiply per point. With no weight (0 & 1), the cost is the same
+ * as an unweighted sum.
+ * @param e is the emitter, in image coordinates
+ * @param templatePhasor is indexed by the offset from the emitter
+ * @param phaseStep is from PackedPhaseStep, for the wavelength
+ * @param weightPhase is the phase of the emitter's weight
+ * @param weightAmp is the magnitude of the emitter's weight
+ * @param phasorArr is the output. It also defines the area to add to, so
+ * it may be part of a larger array
+ */
+void ImageGen::AddPhasorArr(const EmitterI& e, Packed2DConstView_C templatePhasor, quint64 phaseStep,
+                            FastTrig::Phase weightPhase, float weightAmp, Complex2DView_C phasorArr) {
+    // Move the template origin to the emitter location, to line it up with phasorArr
+    templatePhasor = templatePhasor.translated(e.loc);
 
     // Checks
-    if (!templateDist.rect().contains(phasorArr.rect())) {
-        qFatal("addPhasorArr - templateDist doesn't contain required offsets!");
+    if (!templatePhasor.rect().contains(phasorArr.rect())) {
+        qFatal("addPhasorArr - templatePhasor doesn't contain required offsets!");
         return;
     }
-    if (!templateAmp.rect().contains(phasorArr.rect())) {
-        qFatal("addPhasorArr - templateAmp doesn't contain required offsets!");
-        return;
+
+    const int32_t x0 = phasorArr.xLeft;
+    const int32_t xe = phasorArr.xLeft + phasorArr.width;
+    for (int32_t y = phasorArr.yTop; y < phasorArr.yTop + phasorArr.height; y++) {
+        const PackedPhasor* src = templatePhasor.row(y);
+        complex* dst = phasorArr.row(y);
+        for (int32_t x = x0; x < xe; x++) {
+            FastTrig::Phase phase = (FastTrig::Phase)(((quint64)src[x].dist * phaseStep) >> 16) + weightPhase;
+            double amp = src[x].amp * weightAmp;
+            dst[x] += complex(amp * FastTrig::Cos(phase), amp * FastTrig::Sin(phase));
+        }
     }
-    if (!templatePhasor.rect().contains(phasorArr.rect())) {
-        qFatal("addPhasorArr - templateAmp doesn't contain required offsets!");
+    return;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::AddPhasorArrSpectral is AddPhasorArr for several
+ * wavelengths at once (spectral mode). Each template point is read once, and
+ * added to the sum of every wavelength, so the memory traffic is the same as
+ * for one wavelength.
+ * @param e is the emitter, in image coordinates
+ * @param templatePhasor is indexed by the offset from the emitter
+ * @param phaseStep for each wavelength, from PackedPhaseStep
+ * @param weightPhase for each wavelength
+ * @param weightAmp is the magnitude of the emitter's weight
+ * @param phasorArr for each wavelength. The first defines the area to add to
+ */
+void ImageGen::AddPhasorArrSpectral(const EmitterI& e, Packed2DConstView_C templatePhasor,
+                                    const quint64 *phaseStep, const FastTrig::Phase *weightPhase, float weightAmp,
+                                    const Complex2DView_C *phasorArr) {
+    const qint32 count = GenSettings::spectralCount;
+    templatePhasor = templatePhasor.translated(e.loc);
+
+    // Checks
+    if (!templatePhasor.rect().contains(phasorArr[0].rect())) {
+        qFatal("addPhasorArr - templatePhasor doesn't contain required offsets!");
         return;
     }
 
-    // templateDist is in image units (pixels)
-    for (int32_t y = rect.top(); y < rect.top() + rect.height(); y++) {
-        for (int32_t x = rect.x(); x < rect.x() + rect.width(); x++) {
-            phasorArr.addPoint(x, y, templatePhasor.getPoint(x, y));
-//            fpComplex amp = templateAmp.getPoint(x,y);
-//            qreal angle = (templateDist.getPoint(x, y) + distOffsetImg) * radPerImg;
-//            phasorArr.addPoint(x, y, complex(amp * cos(angle), amp * sin(angle)));
+    const int32_t x0 = phasorArr[0].xLeft;
+    const int32_t xe = phasorArr[0].xLeft + phasorArr[0].width;
+    for (int32_t y = phasorArr[0].yTop; y < phasorArr[0].yTop + phasorArr[0].height; y++) {
+        const PackedPhasor* src = templatePhasor.row(y);
+        complex* dst[count];
+        for (qint32 c = 0; c < count; c++) {
+            dst[c] = phasorArr[c].row(y);
+        }
+        for (int32_t x = x0; x < xe; x++) {
+            const quint64 dist = src[x].dist;
+            const double amp = src[x].amp * weightAmp;
+            for (qint32 c = 0; c < count; c++) {
+                FastTrig::Phase phase = (FastTrig::Phase)((dist * phaseStep[c]) >> 16) + weightPhase[c];
+                dst[c][x] += complex(amp * FastTrig::Cos(phase), amp * FastTrig::Sin(phase));
+            }
         }
     }
-    // Restore the phasorArr coordinates
-    phasorArr.translate(e.loc);
-    return;
 }
 
+/** ****************************************************************************
+ * @brief ImageGen::SumPhasors adds the phasor template of every emitter into
+ * the phasor sums. The arrays are split into bands of rows that are summed in
+ * parallel. Each band stays in cache while every emitter is added to it.
+ * If genSet has no phasor template (memory is short), the phasors are
+ * calculated from the distance & amplitude templates instead.
+ * @param emittersImg
+ * @param genSet holds the templates
+ * @param wavelengths (sim units) for each sum
+ * @param sums are added to (phasorArr). New arrays start at 0. All are the
+ * same size
+ * @param sumCount is 1, or GenSettings::spectralCount for spectral mode
+ */
+void ImageGen::SumPhasors(const QVector<EmitterI> &emittersImg, const GenSettings &genSet, const qreal *wavelengths,
+                          SumArray *sums, qint32 sumCount) {
+    const QRect area = sums[0].phasorArr->rect();
+    const qint32 bandCount = qBound(1, area.height() / sumBandMinRows, QThread::idealThreadCount() * 4);
+    QVector<QRect> bands;
+    for (qint32 i = 0; i < bandCount; i++) {
+        qint32 top = area.top() + area.height() * i / bandCount;
+        qint32 bottom = area.top() + area.height() * (i + 1) / bandCount;
+        bands.append(QRect(area.left(), top, area.width(), bottom - top));
+    }
+    Complex2DView_C out[GenSettings::spectralCount];
+    for (qint32 c = 0; c < sumCount; c++) {
+        out[c] = sums[c].phasorArr->view();
+    }
+    if (genSet.usePhasorTemplate) {
+        const Packed2DConstView_C tmpl = genSet.templatePhasor.arr->constView();
+        quint64 phaseStep[GenSettings::spectralCount];
+        for (qint32 c = 0; c < sumCount; c++) {
+            phaseStep[c] = PackedPhaseStep(wavelengths[c], genSet.templatePhasor.imgPerSimUnit);
+        }
+        // The complex weight of each emitter, as a phase (per wavelength) & an amplitude
+        QVector<FastTrig::Phase> weightPhase(emittersImg.size() * sumCount);
+        QVector<float> weightAmp(emittersImg.size());
+        for (qint32 i = 0; i < emittersImg.size(); i++) {
+            for (qint32 c = 0; c < sumCount; c++) {
+                weightPhase[i * sumCount + c] = FastTrig::TurnsToPhase(-emittersImg[i].distOffset / wavelengths[c]);
+            }
+            weightAmp[i] = (float)emittersImg[i].amplitude;
+        }
+        const FastTrig::Phase* wPhase = weightPhase.constData();
+        const float* wAmp = weightAmp.constData();
+        QtConcurrent::blockingMap(bands, [&](const QRect& band) {
+            Complex2DView_C bandOut[GenSettings::spectralCount];
+            for (qint32 c = 0; c < sumCount; c++) {
+                bandOut[c] = out[c].sub(band);
+            }
+            for (qint32 i = 0; i < emittersImg.size(); i++) {
+                if (sumCount == 1) {
+                    AddPhasorArr(emittersImg[i], tmpl, phaseStep[0], wPhase[i], wAmp[i], bandOut[0]);
+                }
+                else {
+                    AddPhasorArrSpectral(emittersImg[i], tmpl, phaseStep, &wPhase[i * sumCount], wAmp[i], bandOut);
+                }
+            }
+        });
+    }
+    else {
+        const Double2DConstView_C dist = genSet.templateDist.arr->constView();
+        const Double2DConstView_C amp = genSet.templateAmp.arr->constView();
+        QtConcurrent::blockingMap(bands, [&](const QRect& band) {
+            for (qint32 c = 0; c < sumCount; c++) {
+                for (const EmitterI& e : emittersImg) {
+                    AddPhasorArr(wavelengths[c], e, dist, amp, out[c].sub(band));
+                }
+            }
+        });
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::SpectralWavelength
+ * @param wavelength is the green wavelength (sim units)
+ * @param channel 0, 1 or 2 for red, green or blue
+ * @return the wavelength for the channel. The ratios are those of red, green
+ * & blue light (650, 530 & 450 nm)
+ */
+qreal ImageGen::SpectralWavelength(qreal wavelength, qint32 channel) {
+    static const qreal ratio[GenSettings::spectralCount] = {650. / 530., 1., 450. / 530.};
+    return wavelength * ratio[channel];
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::CurrentFieldMode
+ * @return the value of the phasor sum that's displayed. While animating,
+ * the real part is shown in place of the amplitude or intensity
+ */
+FieldMode ImageGen::CurrentFieldMode() const {
+    if ((animating || exportingAnimation) && (s.fieldMode == FieldMode::amplitude || s.fieldMode == FieldMode::intensity)) {
+        // These don't change with the time phase
+        return FieldMode::real;
+    }
+    return s.fieldMode;
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::CalcFieldValues calculates the displayed value of a phasor
+ * sum at every point (ampArr), and its range. Only the sum is needed, so this
+ * is all that's repeated when the mode or the time phase changes.
+ * @param sumArr
+ * @param ampMinLimit is the highest value that ampMin is set to (amplitude &
+ * intensity modes, as an amplitude)
+ * @param mode
+ * @param timePhase rotates the phasors (real & phase modes)
+ */
+void ImageGen::CalcFieldValues(SumArray &sumArr, double ampMinLimit, FieldMode mode, FastTrig::Phase timePhase) {
+    const QRect rect = sumArr.phasorArr->rect();
+    if (!sumArr.ampArr || sumArr.ampArr->rect() != rect) {
+        delete sumArr.ampArr;
+        sumArr.ampArr = new Double2D_C(rect);
+    }
+    const Complex2D_C& phasorArr = *sumArr.phasorArr;
+    const Double2D_C& valArr = *sumArr.ampArr;
+    const qint32 x0 = rect.left();
+    const qint32 xe = rect.left() + rect.width();
+    const qint32 y0 = rect.top();
+    const qint32 ye = rect.top() + rect.height();
+
+    switch (mode) {
+    case FieldMode::amplitude:
+        sumArr.ampMax = 0;
+        sumArr.ampMin = ampMinLimit;
+        for (qint32 y = y0; y < ye; y++) {
+            const complex* src = phasorArr.row(y);
+            double* dst = valArr.row(y);
+            for (qint32 x = x0; x < xe; x++) {
+                double amp = std::abs(src[x]);
+                dst[x] = amp;
+                sumArr.ampMin = std::min(sumArr.ampMin, amp);
+                sumArr.ampMax = std::max(sumArr.ampMax, amp);
+            }
+        }
+        break;
+
+    case FieldMode::real: {
+        // The range is set by the largest amplitude, so that it doesn't change
+        // as the time phase turns
+        const double rotRe = FastTrig::Cos(timePhase);
+        const double rotIm = FastTrig::Sin(timePhase);
+        double normMax = 0;
+        for (qint32 y = y0; y < ye; y++) {
+            const complex* src = phasorArr.row(y);
+            double* dst = valArr.row(y);
+            for (qint32 x = x0; x < xe; x++) {
+                dst[x] = src[x].real() * rotRe - src[x].imag() * rotIm;
+                normMax = std::max(normMax, std::norm(src[x]));
+            }
+        }
+        sumArr.ampMax = std::sqrt(normMax);
+        sumArr.ampMin = -sumArr.ampMax;
+        break;
+    }
+
+    case FieldMode::phase: {
+        const double timeRad = timePhase / FastTrig::phasePerRad;
+        for (qint32 y = y0; y < ye; y++) {
+            const complex* src = phasorArr.row(y);
+            double* dst = valArr.row(y);
+            for (qint32 x = x0; x < xe; x++) {
+                double rad = std::arg(src[x]) + timeRad;
+                dst[x] = rad > PI ? rad - 2 * PI : rad;
+            }
+        }
+        sumArr.ampMax = PI;
+        sumArr.ampMin = -PI;
+        break;
+    }
+
+    case FieldMode::intensity:
+        sumArr.ampMax = 0;
+        sumArr.ampMin = ampMinLimit * ampMinLimit;
+        for (qint32 y = y0; y < ye; y++) {
+            const complex* src = phasorArr.row(y);
+            double* dst = valArr.row(y);
+            for (qint32 x = x0; x < xe; x++) {
+                double intensity = std::norm(src[x]);
+                dst[x] = intensity;
+                sumArr.ampMin = std::min(sumArr.ampMin, intensity);
+                sumArr.ampMax = std::max(sumArr.ampMax, intensity);
+            }
+        }
+        break;
+
+    case FieldMode::count:
+        break;
+    }
+}
+
+/** ****************************************************************************
+ * @brief ImageGen::ColourSpectral colours an image in spectral mode. The
+ * amplitude of each wavelength's sum (scaled to its range) sets the red, green
+ * & blue channels. The colour map isn't used.
+ * @param sums for red, green & blue, with amplitudes calculated
+ * @param imageOut is the same size as the sums
+ */
+void ImageGen::ColourSpectral(const SumArray *sums, QImage &imageOut) {
+    const qint32 count = GenSettings::spectralCount;
+    double mult[count];
+    for (qint32 c = 0; c < count; c++) {
+        mult[c] = 255. / (sums[c].ampMax - sums[c].ampMin);
+    }
+    const Double2D_C& a0 = *sums[0].ampArr;
+    for (int y = 0; y < imageOut.height(); y++) {
+        QRgb* pixLine = (QRgb*)imageOut.scanLine(y);
+        const double* ampRow[count];
+        for (qint32 c = 0; c < count; c++) {
+            ampRow[c] = sums[c].ampArr->row(y + a0.yTop) + a0.xLeft;
+        }
+        for (int x = 0; x < imageOut.width(); x++) {
+            int v[count];
+            for (qint32 c = 0; c < count; c++) {
+                v[c] = qBound(0, (int)((ampRow[c][x] - sums[c].ampMin) * mult[c] + 0.5), 255);
+            }
+            pixLine[x] = qRgb(v[0], v[1], v[2]);
+        }
+    }
+}
 
 /** ****************************************************************************
  * @brief ImageGen::ColourAngleToQrgb sets a red, green and blue bytes to a point on a colour wheel
@@ -903,9 +2162,10 @@ int ImageGen::EmitterArrangementToLocs(const EmArrangement & arngmt, QVector<QPo
 
 
 /** ****************************************************************************
- * @brief GetEmitterList creates a vector holding the locations of all emitters
+ * @brief GetEmitterList provides a vector holding the locations of all emitters
  * generated from the arrangements in s.emArrangements)
- * @param emittersImg
+ * The list is cached, and only rebuilt when the emitters stage is invalidated.
+ * @param emitters shares the cached list
  * @returns an error code. 0 for pass.
  */
 int ImageGen::GetEmitterList(QVector<EmitterF> & emitters) {
@@ -915,19 +2175,26 @@ int ImageGen::GetEmitterList(QVector<EmitterF> & emitters) {
         AddArrangement(DefaultArrangement());
     }
 
-    // Build a vector of all emitter locations from the arrangements
-    QVector<QPointF> emLocs;
-    for (EmArrangement arn : s.emArrangements) {
-        QVector<QPointF> thisEmLocs;
-        EmitterArrangementToLocs(arn, thisEmLocs);
-        emLocs.append(thisEmLocs);
-    }
+    if (emitterCacheVersion != stageVersion[Stage::emitters]) {
+        // Build a vector of all emitter locations from the arrangements
+        QVector<QPointF> emLocs;
+        for (const EmArrangement& arn : s.emArrangements) {
+            QVector<QPointF> thisEmLocs;
+            EmitterArrangementToLocs(arn, thisEmLocs);
+            emLocs.append(thisEmLocs);
+        }
 
-    // Create emitters from the locations
-    emitters.resize(emLocs.size());
-    for (int32_t i = 0; i < emLocs.size(); i++) {
-        emitters[i].loc = emLocs[i];
+        // Create emitters from the locations
+        emitterCache.resize(emLocs.size());
+        for (int32_t i = 0; i < emLocs.size(); i++) {
+            emitterCache[i] = EmitterF(emLocs[i]);
+        }
+        if (!s.emittersInSync) {
+            ApplyEnergizer(emitterCache);
+        }
+        emitterCacheVersion = stageVersion[Stage::emitters];
     }
+    emitters = emitterCache;
 
     if (emitters.size() == 0) {
         qWarning("No emitters! Abort drawing");
@@ -937,6 +2204,31 @@ int ImageGen::GetEmitterList(QVector<EmitterF> & emitters) {
     return 0;
 }
 
+/** ****************************************************************************
+ * @brief ImageGen::ApplyEnergizer sets the phase & amplitude of each emitter
+ * from its distance to the energizer. The wave travels from the energizer to
+ * each emitter, so the phase lags by that distance, and the amplitude drops
+ * off with it (relative to an emitter at the mean distance).
+ * @param emitters are modified
+ */
+void ImageGen::ApplyEnergizer(QVector<EmitterF> &emitters) const {
+    if (emitters.isEmpty()) {
+        return;
+    }
+    double meanDist = 0;
+    for (const EmitterF& e : emitters) {
+        meanDist += QLineF(e.loc, s.energizerLoc).length();
+    }
+    meanDist /= emitters.size();
+    double distOffset = meanDist * s.energizerDistOffsetF;
+    for (EmitterF& e : emitters) {
+        double dist = QLineF(e.loc, s.energizerLoc).length();
+        e.distOffset = dist;
+        // With no offset, the amplitude would be infinite at the energizer
+        e.amplitude = distOffset > 0 ? (meanDist + distOffset) / (dist + distOffset) : 1.;
+    }
+}
+
 /** ****************************************************************************
  * @brief ImageGen::DebugEmitterLocs
  * @param emittersImg
@@ -984,11 +2276,71 @@ EmArrangement ImageGen::DefaultArrangement() {
  * @param wavelengthIn
  * @param imgPerSimUnitIn
  */
-void TemplatePhasor::MakeNew(QRect size, qreal wavelengthIn, qreal imgPerSimUnitIn) {
+void TemplatePhasor::MakeNew(QRect size, qreal imgPerSimUnitIn, qreal distOffsetIn) {
     if (this->arr) { delete this->arr; }
-    this->arr = new Complex2D_C(size);
-    this->wavelength = wavelengthIn;
+    this->arr = new Packed2D_C(size);
     this->imgPerSimUnit = imgPerSimUnitIn;
+    this->distOffset = distOffsetIn;
+}
+
+/** ****************************************************************************
+ * @brief SumArray::CacheBytes
+ * @return the memory held by the arrays [bytes]
+ */
+qint64 SumArray::CacheBytes() const {
+    qint64 bytes = 0;
+    if (phasorArr) {bytes += phasorArr->byteCount();}
+    if (ampArr) {bytes += ampArr->byteCount();}
+    return bytes;
+}
+
+/** ****************************************************************************
+ * @brief SumArray::Release frees the arrays
+ */
+void SumArray::Release() {
+    delete phasorArr;
+    phasorArr = nullptr;
+    delete ampArr;
+    ampArr = nullptr;
+}
+
+/** ****************************************************************************
+ * @brief GenSettings::CacheBytes
+ * @return the memory held by the cached arrays & images [bytes]
+ */
+qint64 GenSettings::CacheBytes() const {
+    qint64 bytes = 0;
+    if (templateDist.arr) {bytes += templateDist.arr->byteCount();}
+    if (templateAmp.arr) {bytes += templateAmp.arr->byteCount();}
+    if (templatePhasor.arr) {bytes += templatePhasor.arr->byteCount();}
+    bytes += combinedArr.CacheBytes();
+    for (const SumArray& sumArr : spectralArr) {
+        bytes += sumArr.CacheBytes();
+    }
+    bytes += (qint64)fourBarRaster.bytesPerLine() * fourBarRaster.height();
+    bytes += fourBarDensity.CacheBytes();
+    return bytes;
+}
+
+/** ****************************************************************************
+ * @brief GenSettings::ReleaseCaches frees the cached arrays & images. They're
+ * rebuilt by the next image generated with these settings.
+ */
+void GenSettings::ReleaseCaches() {
+    delete templateDist.arr;
+    templateDist.arr = nullptr;
+    delete templateAmp.arr;
+    templateAmp.arr = nullptr;
+    delete templatePhasor.arr;
+    templatePhasor.arr = nullptr;
+    combinedArr.Release();
+    for (SumArray& sumArr : spectralArr) {
+        sumArr.Release();
+    }
+    fourBarRaster = QImage();
+    fourBarRasterSteps = 0;
+    fourBarDensity = FourBarDensity();
+    builtVersion = StageVersions();
 }
 
 
@@ -7,8 +7,16 @@
 #include <QList>
 #include <QPainter>
 #include <QGraphicsView>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include "datatypes.h"
 #include "colourmap.h"
+#include "framequeue.h"
+#include "framescheduler.h"
+#include "fourbar.h"
+#include "fasttrig.h"
+#include "interact.h"
 
 void ImageDataDealloc(void * info);
 
@@ -23,17 +31,41 @@ public:
     // PROGRAM SETTINGS
 
     static constexpr qreal templateOversizeFactor = 1.2; // The amount of extra length that the templates are calculated for (to prevent repeated recalculations)
-    static constexpr int trigTableLen = 10000;
+    static constexpr qreal minImgPointsQuick = 20000; // Lower limit for the adaptive quick image size
+    static constexpr qreal maxImgPointsQuick = GenSettings::dfltImgPointsPreview; // Upper limit for the adaptive quick image size
+    static constexpr qint32 exportTileSize = 512; // Tile width & height for tiled image saves [pixels]
+    static constexpr qint64 streamExportMinPixels = 50000000; // Tiled saves larger than this are streamed to the file
+    static constexpr qint64 memBudgetDfltMB = 4096; // The default memory budget for cached arrays. Override with the environment variable WAVEPAPER_MEM_BUDGET_MB
+    static constexpr qint32 animIntervalMs = 16; // Animation frame interval (~60 fps)
+    static constexpr qreal animTurnsPerSec = 0.5; // Animation speed. Revolutions of the time phase per second
+    static constexpr qint32 animExportFrames = 60; // Frames per period in exported animations
+    static constexpr qint32 sumBandMinRows = 16; // The phasor sum is split into bands of at least this many rows, summed in parallel
 
 private:
+    struct PrefetchedTemplates {
+        TemplateDist dist;
+        TemplateAmp amp;
+        TemplatePhasor phasor;
+    };
+
     MainWindow * mainWindow = nullptr;
-    bool pendingQuickImage; // True if a quick image is pending to be generated
-    bool pendingPreviewImage; // True if a preview image is pending to be generated
     bool hideEmitters = true; // When true, the emitters are not drawn on the preview window
-    double sinTable[trigTableLen]; // Pre-calculated sin values. Indices 0 to trigTableLen correspond to 0 to 2pi rad
-    double cosTable[trigTableLen]; // Pre-calculated cos values. Indices 0 to trigTableLen correspond to 0 to 2pi rad
-    inline double sinQuick(double rad) {return sinTable[modPos((int)(rad*(double)trigTableLen/(2.*PI)),trigTableLen)];}
-    inline double cosQuick(double rad) {return cosTable[modPos((int)(rad*(double)trigTableLen/(2.*PI)),trigTableLen)];}
+    qreal quickImgPoints = GenSettings::dfltImgPointsQuick; // Target pixels in the quick image. Adapted to keep quick frames within budget
+    bool prefetchTemplateArea = false; // True to prefetch templates large enough for emitters anywhere in the view
+    QFutureWatcher<PrefetchedTemplates*> prefetchWatcher; // Watches the templates being prefetched in the background
+    StageVersions stageVersion; // The current version of each pipeline stage. See Invalidate
+    quint64 stageSerial = 0; // The last version issued to a stage
+    QVector<EmitterF> emitterCache; // Cached emitter list, built from s.emArrangements
+    quint64 emitterCacheVersion = 0; // The emitters stage version that emitterCache was built from
+    qint64 memBudgetBytes = memBudgetDfltMB << 20; // Limit for the cached arrays of all GenSettings, plus the buffer pool
+    quint64 renderCount = 0; // Incremented for every image generated. Used for least recently used eviction
+    // Animation
+    QTimer animTimer; // Advances the animation
+    QElapsedTimer animClock; // Time since the animation started
+    qreal animTurnsStart = 0; // The time phase when animClock started [revolutions]
+    qreal animTurns = 0; // The time phase of the displayed field [revolutions]
+    bool animating = false; // True while the animation timer runs
+    bool exportingAnimation = false; // True while an animation is saved
 
 public:
     Settings s; // Contains entire setup
@@ -47,8 +79,9 @@ public:
     qint32 outHeightPix = 1080; // The output will be rendered to this many pixels high
     bool saveWithTransparency = false; // If true, when an image with a mask is saved, it will be saved with transparency. If false, then the background colour will be rendered into the image
 
-    QImage imgPreview;
-    QImage imgQuick;
+    FrameQueue frameQueue; // Completed quick & preview frames, handed to the preview view
+    FrameScheduler scheduler; // Decides when quick & preview frames are rendered
+    FourBar::Geometry fourBarGeom; // The four bar path, shared by the quick & preview images
     qint32 testVal = 1;
     ColourMap colourMap;
 
@@ -63,23 +96,32 @@ public:
     int InitViewAreas();
 
     int GetEmitterList(QVector<EmitterF> &emitters);
+    void Invalidate(Stage stage);
+    void InvalidateAll();
+    void InvalidateField(const void *field);
     static void DebugEmitterLocs(const QVector<EmitterI>& emittersImg);
     static void DebugEmitterLocs(const QVector<EmitterF> &emittersF);
     static EmArrangement DefaultArrangement();
     void setTargetImgPoints(qint32 imgPoints, GenSettings &genSet) const;
+    void setTargetImgSize(QSize imgSize, GenSettings &genSet) const;
+    qreal GetQuickImgPoints() const {return quickImgPoints;}
+    static qint32 PixelDivisor(QSize devicePixSize, qreal maxImgPoints);
+
+    void PrefetchForDrag(Interact::Type interactType);
 
     void setDistOffsetF(qreal in) {s.distOffsetF = in;}
     qreal getDistOffsetF() const {return s.distOffsetF;}
     bool EmittersHidden();
 
     void SaveImage(); // Saves to a file
+    void SaveAnimation(); // Saves one period of the animation to a PNG sequence
     void AddArrangement(EmArrangement emArrangementIn); // Adds the given emitter arrangement
     void ResetSettings();
 
 signals:
-    void NewImageReady(QImage & image, qreal imgPerSimUnitOut, QColor backgroundClr); // A new image is ready
+    void NewFrameReady(); // A new frame has been published to frameQueue
     void EmitterArngmtChanged(); // Emitted when the emitter locations change
-    void GenerateImageSignal(); // Just used to queue up GenerateImageSlot
+    void GenerateImageSignal(); // Emitted whenever a new image is requested
     void OverlayTextSignal(QString text);
 
 public slots:
@@ -92,9 +134,26 @@ public slots:
         emit EmitterArngmtChanged();
     }
     bool GetHideEmitters() { return hideEmitters; }
+    void SetAnimating(bool animate);
+    void ToggleAnimation() {SetAnimating(!animating);}
 
 private slots:
-    void GenerateImageSlot();
+    void RenderQuickFrame();
+    void RenderPreviewFrame();
+    void RunPrefetch();
+    void InstallPrefetchedTemplates();
+    void AnimationTick();
+
+private:
+    bool StageStale(const GenSettings &genSet, Stage stage) const {return genSet.builtVersion[stage] != stageVersion[stage];}
+    void StageBuilt(GenSettings &genSet, Stage stage) const {genSet.builtVersion[stage] = stageVersion[stage];}
+    static void ResetImageStages(GenSettings &genSet);
+    qint64 OtherCacheBytes(const GenSettings &genSet) const;
+    qint64 ProjectedCacheBytes(const GenSettings &genSet, QRect templateRect, bool oversize, bool phasorTemplate) const;
+    bool EnsureMemory(GenSettings &genSet, QRect templateRect);
+    static void SetTemplateMode(GenSettings &genSet, bool oversize, bool phasorTemplate);
+    bool RenderFrame(GenSettings &genSet);
+    void AdaptQuickImgPoints(const GenSettings &genSet);
 
 private:
     static void CalcDistArr(double simUnitPerIndex, Double2D_C &arr);
@@ -102,17 +161,38 @@ private:
     static void CalcPhasorArr(TemplatePhasor& templatePhasor,
                               const Double2D_C & templateDist, const Double2D_C & templateAmp);
     static QRgb ColourAngleToQrgb(int32_t angle, uint8_t alpha = 255);
-    void AddPhasorArr(double imgPerSimUnit, double wavelength, EmitterI e, const Double2D_C & templateDist,
-                      const Double2D_C & templateAmp, Complex2D_C & phasorArr);
-    static void AddPhasorArr(const EmitterI& e, const Double2D_C &templateDist, const Double2D_C &templateAmp, const Complex2D_C &templatePhasor, Complex2D_C &phasorArr);
+    static quint64 PackedPhaseStep(double wavelength, double imgPerSimUnit);
+    static void AddPhasorArr(double wavelength, EmitterI e, Double2DConstView_C templateDist,
+                             Double2DConstView_C templateAmp, Complex2DView_C phasorArr);
+    static void AddPhasorArr(const EmitterI& e, Packed2DConstView_C templatePhasor, quint64 phaseStep,
+                             FastTrig::Phase weightPhase, float weightAmp, Complex2DView_C phasorArr);
+    static void AddPhasorArrSpectral(const EmitterI& e, Packed2DConstView_C templatePhasor,
+                                     const quint64 *phaseStep, const FastTrig::Phase *weightPhase, float weightAmp,
+                                     const Complex2DView_C *phasorArr);
+    static void SumPhasors(const QVector<EmitterI> &emittersImg, const GenSettings &genSet, const qreal *wavelengths,
+                           SumArray *sums, qint32 sumCount);
+    static qreal SpectralWavelength(qreal wavelength, qint32 channel);
+    FieldMode CurrentFieldMode() const;
+    static void CalcFieldValues(SumArray &sumArr, double ampMinLimit, FieldMode mode, FastTrig::Phase timePhase);
+    static void ColourSpectral(const SumArray *sums, QImage &imageOut);
+    void ApplyEnergizer(QVector<EmitterF> &emitters) const;
     static int EmitterArrangementToLocs(const EmArrangement &arngmt, QVector<QPointF> &emLocsOut);
     void CalcDistTemplate(QRect templateRect, GenSettings &genSet);
     void CalcAmpTemplate(qreal distOffset, GenSettings &genSet);
     void CalcPhasorTemplate(QRect templateRect, GenSettings &genSet);
+    qreal TemplateDistOffset(const GenSettings &genSet) const;
+    void PrefetchTemplateArea(GenSettings &genSet);
+    static PrefetchedTemplates* BuildTemplates(QRect templateRect, qreal imgPerSimUnit, qreal distOffset);
 
-    void PreCalcTrigTables();
+    bool UpdateColourIndex(GenSettings &genSet);
     int GenerateImageWaves(QImage &imageOut, GenSettings &genSet);
     int GenerateImageFourBar(QImage &imageOut, GenSettings &genSet);
+    int SaveImageFourBarTiled(const QString &fileName, GenSettings &genSet);
+    int SaveImageFourBarDensityTiled(const QString &fileName, GenSettings &genSet);
+    QImage ImageForSave(const QImage &img) const;
+    void ToneMapDensity(const QVector<float> &density, QImage &imageOut, GenSettings &genSet);
+    static qreal DensityToneScale(float maxDensity);
+    void ToneMapDensityRow(const float *density, qint32 width, qreal mult, QRgb *pixLine, GenSettings &genSet);
 };
 
 extern ImageGen imageGen;
@@ -87,6 +87,7 @@ void Interact::mousePressEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sc
     case Type::wavelength:
         wavelengthBackup = imgGen.s.wavelength;
         distOffsetBackup = imgGen.s.distOffsetF;
+        distOffsetPrev = imgGen.s.distOffsetF;
         break;
 
     case Type::lengths:
@@ -102,6 +103,7 @@ void Interact::mousePressEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sc
         break;
     }
     active = typeSelected;
+    imgGen.PrefetchForDrag(active);
 }
 
 /** ****************************************************************************
@@ -198,6 +200,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
         }
 
 
+        imgGen.InvalidateField(grpActive);
         emit imgGen.EmitterArngmtChanged();
     }
     else if (active == Type::arrangement2) {
@@ -222,6 +225,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
             break;
         }
 
+        imgGen.InvalidateField(grpActive);
         emit imgGen.EmitterArngmtChanged();
     }
     else if (active == Type::location) {
@@ -238,13 +242,20 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
             grpActive->center.setY(Snap(grpActive->center.y(), 9e9, imgGen.areaSim.width() * 0.05));
         }
 
+        imgGen.InvalidateField(grpActive);
         emit imgGen.EmitterArngmtChanged();
     }
     else if (active == Type::wavelength) {
         // *********************************************************************
         // Wavelength edit
+        // The templates don't depend on the wavelength, so only the sum is recalculated
         imgGen.s.wavelength = std::max(0.5, wavelengthBackup * (1. + deltaRatio.x() * 0.5));
         imgGen.s.distOffsetF = qBound(0., distOffsetBackup  + deltaRatio.y(), 1.);
+        imgGen.InvalidateField(&imgGen.s.wavelength);
+        if (imgGen.s.distOffsetF != distOffsetPrev) {
+            imgGen.InvalidateField(&imgGen.s.distOffsetF);
+            distOffsetPrev = imgGen.s.distOffsetF;
+        }
     }
     else if (active == Type::colours) {
         // *********************************************************************
@@ -290,6 +301,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
             newMaskCfg.dutyCycle = qBound(0.0, maskConfigBackup.dutyCycle - deltaRatio.y() * 1.0, 1.0);
         }
         imgGen.s.maskCfg = newMaskCfg;
+        imgGen.InvalidateField(&imgGen.s.maskCfg);
     }
     else if (active == Type::lengths) {
         // *********************************************************************
@@ -298,6 +310,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
         newFbCfg.lenRatioB = newFbCfg.lenRatioB * (1 + deltaRatio.x());
         newFbCfg.lenRatio2 = newFbCfg.lenRatio2 * (1 + deltaRatio.y());
         imgGen.s.fourBar = newFbCfg;
+        imgGen.InvalidateField(&imgGen.s.fourBar);
     }
     else if (active == Type::angleInc) {
         // *********************************************************************
@@ -306,6 +319,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
         newFbCfg.revRatioB = fourBarBackup.revRatioB * (1 + deltaRatio.x() * 0.01);
 
         imgGen.s.fourBar = newFbCfg;
+        imgGen.InvalidateField(&imgGen.s.fourBar);
     }
     else if (active == Type::position) {
         // *********************************************************************
@@ -315,6 +329,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
         newFbCfg.baseOffsetY = fourBarBackup.baseOffsetY + deltaRatio.y();
 
         imgGen.s.fourBar = newFbCfg;
+        imgGen.InvalidateField(&imgGen.s.fourBar);
     }
     else if (active == Type::drawRange) {
         // *********************************************************************
@@ -323,6 +338,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
         newFbCfg.revCount = fourBarBackup.revCount * (1 + deltaRatio.x() * 1.);
         newFbCfg.initAngleOffset = fourBarBackup.initAngleOffset + deltaRatio.y() * 2. * PI;
         imgGen.s.fourBar = newFbCfg;
+        imgGen.InvalidateField(&imgGen.s.fourBar);
     }
     else if (active == Type::angleInit) {
         // *********************************************************************
@@ -332,6 +348,7 @@ void Interact::mouseMoveEvent(QGraphicsSceneMouseEvent *event, PreviewScene *sce
         newFbCfg.ta1Init = fourBarBackup.ta1Init + deltaRatio.x() * 2. * PI;
         newFbCfg.initAngleOffset = fourBarBackup.initAngleOffset + deltaRatio.y() * 2. * PI;
         imgGen.s.fourBar = newFbCfg;
+        imgGen.InvalidateField(&imgGen.s.fourBar);
     }
 
 
@@ -352,6 +369,7 @@ void Interact::Cancel() {
     case Type::location:
         if (grpActive) {
             *grpActive = grpBackup;
+            imgGen.InvalidateField(grpActive);
         }
         emit imgGen.EmitterArngmtChanged();
         break;
@@ -362,11 +380,14 @@ void Interact::Cancel() {
 
     case Type::mask:
         imgGen.s.maskCfg = maskConfigBackup;
+        imgGen.InvalidateField(&imgGen.s.maskCfg);
         break;
 
     case Type::wavelength:
         imgGen.s.wavelength = wavelengthBackup;
         imgGen.s.distOffsetF = distOffsetBackup;
+        imgGen.InvalidateField(&imgGen.s.wavelength);
+        imgGen.InvalidateField(&imgGen.s.distOffsetF);
         break;
 
     case Type::lengths:
@@ -375,6 +396,7 @@ void Interact::Cancel() {
     case Type::angleInit:
     case Type::drawRange:
         imgGen.s.fourBar = fourBarBackup;
+        imgGen.InvalidateField(&imgGen.s.fourBar);
         break;
     }
     imgGen.NewPreviewImageNeeded();
@@ -415,14 +437,22 @@ void Interact::KeyPressEvent(QKeyEvent *event)
         break;
     case Qt::Key_Plus: // !@# temp
         imgGen.s.fourBar.temp *= 1.2;
+        imgGen.InvalidateField(&imgGen.s.fourBar.temp);
         qDebug("imgGen.s.fourBar.temp = %.4f", imgGen.s.fourBar.temp);
         imgGen.NewImageNeeded();
         break;
     case Qt::Key_Minus: // !@# temp
         imgGen.s.fourBar.temp *= (1./1.2);
+        imgGen.InvalidateField(&imgGen.s.fourBar.temp);
         qDebug("imgGen.s.fourBar.temp = %.4f", imgGen.s.fourBar.temp);
         imgGen.NewImageNeeded();
         break;
+    case Qt::Key_Space:
+        imgGen.ToggleAnimation();
+        break;
+    case Qt::Key_E:
+        imgGen.SaveAnimation();
+        break;
     case Qt::Key_Escape:
         Cancel();
         break;
@@ -44,6 +44,7 @@ private:
     EmArrangement * grpActive;
     qreal wavelengthBackup;
     qreal distOffsetBackup;
+    qreal distOffsetPrev; // The distance offset at the previous mouse move event. The templates are only rebuilt when it changes
     // For mask changes
     MaskCfg maskConfigBackup;
     // For colour list changes
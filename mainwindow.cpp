@@ -5,6 +5,7 @@
 #include <QPushButton>
 #include <QBrush>
 #include <QKeyEvent>
+#include <QActionGroup>
 #include "previewscene.h"
 #include "imagegen.h"
 #include "interact.h"
@@ -68,8 +69,8 @@ MainWindow::MainWindow(QWidget *parent)
     layoutCentral.addWidget(previewView);
     previewView->setScene(previewScene);
 
-    QObject::connect(&imageGen, &ImageGen::NewImageReady,
-                     previewView, &PreviewView::OnPatternImageChange);
+    QObject::connect(&imageGen, &ImageGen::NewFrameReady,
+                     previewView, &PreviewView::OnNewFrame);
 
     QObject::connect(&imageGen, &ImageGen::OverlayTextSignal,
                      previewScene, &PreviewScene::OverlayTextSlot);
@@ -101,6 +102,20 @@ MainWindow::MainWindow(QWidget *parent)
     QObject::connect(ui->actionImageSize, &QAction::triggered,
                      imgSizeValEditor, &ValueEditorGroupWidget::setVisible);
 
+    // Field mode actions. The data of each is its FieldMode
+    fieldModeGroup = new QActionGroup(this);
+    fieldModeGroup->setExclusive(true);
+    ui->actionFieldAmplitude->setData((qint32)FieldMode::amplitude);
+    ui->actionFieldReal->setData((qint32)FieldMode::real);
+    ui->actionFieldPhase->setData((qint32)FieldMode::phase);
+    ui->actionFieldIntensity->setData((qint32)FieldMode::intensity);
+    for (QAction* action : {ui->actionFieldAmplitude, ui->actionFieldReal,
+                            ui->actionFieldPhase, ui->actionFieldIntensity}) {
+        fieldModeGroup->addAction(action);
+    }
+    QObject::connect(fieldModeGroup, &QActionGroup::triggered,
+                     this, &MainWindow::OnFieldModeAction);
+
 
     // Preview scene
     qDebug() << "Preview view rect " << RectToQString(previewView->rect());
@@ -112,6 +127,11 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Value editors
 
+    // Edited values invalidate the render stages that depend on them
+    QObject::connect(valueEditorWidget, &ValueEditorGroupWidget::FieldEditedSig, &imageGen, &ImageGen::InvalidateField);
+    QObject::connect(emitterValEditor, &ValueEditorGroupWidget::FieldEditedSig, &imageGen, &ImageGen::InvalidateField);
+    QObject::connect(imgSizeValEditor, &ValueEditorGroupWidget::FieldEditedSig, &imageGen, &ImageGen::InvalidateField);
+
     // valueEditorWidget
     QObject::connect(valueEditorWidget, &ValueEditorGroupWidget::ValueEditedSig, &imageGen, &ImageGen::NewImageNeeded);
     QObject::connect(valueEditorWidget, &ValueEditorGroupWidget::ValueEditedQuickSig, &imageGen, &ImageGen::NewQuickImageNeeded);
@@ -149,6 +169,7 @@ MainWindow::MainWindow(QWidget *parent)
     imgSizeValEditor->AddValueEditor(new SliderSpinEditor("Save image height (pix)", &imageGen.outHeightPix, 100, 10000));
 
     QObject::connect(imgSizeValEditor, &ValueEditorGroupWidget::ValueEditedSig, &imageGen,  &ImageGen::InitViewAreas);
+    QObject::connect(imgSizeValEditor, &ValueEditorGroupWidget::ValueEditedSig, previewView,  &PreviewView::UpdateImageSizes);
     QObject::connect(imgSizeValEditor, &ValueEditorGroupWidget::ValueEditedSig, &imageGen, &ImageGen::NewImageNeeded);
 
     // Text window for debugging
@@ -195,6 +216,9 @@ void MainWindow::InitMode()
     if (programMode == ProgramMode::waves) {
         valueEditorWidget->AddValueEditor(new SliderSpinEditor("Wavelength", &imageGen.s.wavelength, 1, 50, 1));
         valueEditorWidget->AddValueEditor(new SliderSpinEditor("Linearity", &imageGen.s.distOffsetF, 0, 1.0, 2));
+        valueEditorWidget->AddValueEditor(new SliderSpinEditor("Energizer X", &imageGen.s.energizerLoc.rx(), -100, 100, 1));
+        valueEditorWidget->AddValueEditor(new SliderSpinEditor("Energizer Y", &imageGen.s.energizerLoc.ry(), -100, 100, 1));
+        valueEditorWidget->AddValueEditor(new SliderSpinEditor("Energizer linearity", &imageGen.s.energizerDistOffsetF, 0, 2.0, 2));
 
         valueEditorWidget->AddValueEditor(new SliderSpinEditor("Mask Revolutions", &imageGen.s.maskCfg.numRevs, 1, 80, 0));
         valueEditorWidget->AddValueEditor(new SliderSpinEditor("Mask Offset", &imageGen.s.maskCfg.offset, 0, 1, 2));
@@ -258,6 +282,7 @@ void MainWindow::InitMode()
     QList<QAction *> addSeparatorBefore;
     actionsToAdd.append(ui->actionSaveImage);
     actionsToAdd.append(ui->actionImageSize);
+    actionsToAdd.append(ui->actionExactPixelSize);
     actionsToAdd.append(ui->actionReset);
     addSeparatorBefore.append(ui->actionWaveMode);
     actionsToAdd.append(ui->actionWaveMode);
@@ -270,6 +295,11 @@ void MainWindow::InitMode()
         actionsToAdd.append(ui->actionMirrorHor);
         actionsToAdd.append(ui->actionMirrorVert);
         actionsToAdd.append(ui->actionMaskEnable);
+        actionsToAdd.append(ui->actionSpectralMode);
+        actionsToAdd.append(ui->actionEmittersInSync);
+
+        addSeparatorBefore.append(ui->actionFieldAmplitude);
+        actionsToAdd.append(fieldModeGroup->actions());
 
         addSeparatorBefore.append(ui->actionEditGroup);
         actionsToAdd.append(ui->actionEditGroup);
@@ -284,6 +314,7 @@ void MainWindow::InitMode()
         actionsToAdd.append(ui->actionFbEditLengths);
         actionsToAdd.append(ui->actionFbEditAngleInc);
         actionsToAdd.append(ui->actionFbEditDrawRange);
+        actionsToAdd.append(ui->actionDensityMode);
     }
 
     ui->toolBarHorz->addActions(actionsToAdd);
@@ -295,8 +326,15 @@ void MainWindow::InitMode()
     ui->actionWaveMode->setChecked(programMode == ProgramMode::waves);
     ui->actionFourBarMode->setChecked(programMode == ProgramMode::fourBar);
     ui->actionHideEmitters->setChecked(imageGen.GetHideEmitters());
+    ui->actionSpectralMode->setChecked(imageGen.s.spectralMode);
+    ui->actionEmittersInSync->setChecked(imageGen.s.emittersInSync);
+    ui->actionDensityMode->setChecked(imageGen.s.fourBar.densityMode);
+    for (QAction* action : fieldModeGroup->actions()) {
+        action->setChecked((FieldMode)action->data().toInt() == imageGen.s.fieldMode);
+    }
 
     ui->actionImageSize->setChecked(imgSizeValEditor->isVisible());
+    ui->actionExactPixelSize->setChecked(previewView->exactPixelSize);
 
     // Scene
     previewScene->EmittersToGraphItems(imageGen);
@@ -365,6 +403,7 @@ void MainWindow::on_actionMaskEnable_triggered(bool checked)
 {
     if (checked != imageGen.s.maskCfg.enabled) {
         imageGen.s.maskCfg.enabled = checked;
+        imageGen.InvalidateField(&imageGen.s.maskCfg.enabled);
         imageGen.NewPreviewImageNeeded();
     }
     // Change checkboxes
@@ -377,6 +416,73 @@ void MainWindow::on_actionMaskEnable_triggered(bool checked)
     ui->actionShowMaskChart->setEnabled(checked);
 }
 
+/** ****************************************************************************
+ * @brief MainWindow::on_actionSpectralMode_triggered
+ * @param checked
+ */
+void MainWindow::on_actionSpectralMode_triggered(bool checked)
+{
+    if (checked != imageGen.s.spectralMode) {
+        imageGen.s.spectralMode = checked;
+        imageGen.InvalidateField(&imageGen.s.spectralMode);
+        imageGen.NewPreviewImageNeeded();
+    }
+}
+
+/** ****************************************************************************
+ * @brief MainWindow::on_actionEmittersInSync_triggered
+ * @param checked
+ */
+void MainWindow::on_actionEmittersInSync_triggered(bool checked)
+{
+    if (checked != imageGen.s.emittersInSync) {
+        imageGen.s.emittersInSync = checked;
+        imageGen.InvalidateField(&imageGen.s.emittersInSync);
+        imageGen.NewPreviewImageNeeded();
+    }
+}
+
+/** ****************************************************************************
+ * @brief MainWindow::on_actionDensityMode_triggered
+ * @param checked
+ */
+void MainWindow::on_actionDensityMode_triggered(bool checked)
+{
+    if (checked != imageGen.s.fourBar.densityMode) {
+        imageGen.s.fourBar.densityMode = checked;
+        imageGen.InvalidateField(&imageGen.s.fourBar.densityMode);
+        imageGen.NewPreviewImageNeeded();
+    }
+}
+
+/** ****************************************************************************
+ * @brief MainWindow::on_actionExactPixelSize_triggered
+ * @param checked
+ */
+void MainWindow::on_actionExactPixelSize_triggered(bool checked)
+{
+    if (checked != previewView->exactPixelSize) {
+        previewView->exactPixelSize = checked;
+        previewView->UpdateImageSizes();
+        imageGen.NewImageNeeded();
+    }
+}
+
+/** ****************************************************************************
+ * @brief MainWindow::OnFieldModeAction is called when a field mode action is
+ * triggered
+ * @param action is the checked action. Its data is the FieldMode
+ */
+void MainWindow::OnFieldModeAction(QAction *action)
+{
+    FieldMode fieldMode = (FieldMode)action->data().toInt();
+    if (fieldMode != imageGen.s.fieldMode) {
+        imageGen.s.fieldMode = fieldMode;
+        imageGen.InvalidateField(&imageGen.s.fieldMode);
+        imageGen.NewPreviewImageNeeded();
+    }
+}
+
 /** ****************************************************************************
  * @brief MainWindow::OnInteractChange slot is called when the interaction type
  * is changed. It sets the UI buttons accordingly
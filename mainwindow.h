@@ -15,6 +15,7 @@
 #include "colourmap.h"
 
 class ColourMapEditorWidget;
+class QActionGroup;
 
 #define VERSION_MAJOR 0
 #define VERSION_MINOR 2
@@ -54,10 +55,12 @@ public slots:
     void OnInteractChange(QVariant interactType);
     void ChangeModeToWaves();
     void ChangeModeToFourBar();
+    void OnFieldModeAction(QAction* action);
 private:
     Ui::MainWindow *ui;
     QWidget centralWidget;
     QHBoxLayout layoutCentral;
+    QActionGroup * fieldModeGroup = nullptr; // One checked action per FieldMode
 
 
     // QWidget interface
@@ -71,6 +74,10 @@ private slots:
     void on_actionMirrorHor_triggered(bool checked);
     void on_actionMirrorVert_triggered(bool checked);
     void on_actionMaskEnable_triggered(bool checked);
+    void on_actionSpectralMode_triggered(bool checked);
+    void on_actionEmittersInSync_triggered(bool checked);
+    void on_actionDensityMode_triggered(bool checked);
+    void on_actionExactPixelSize_triggered(bool checked);
     void on_actionHideEmitters_toggled(bool arg1);
     void on_actionMaskEdit_toggled(bool arg1);
     void on_actionColoursEdit_toggled(bool arg1);
@@ -0,0 +1,177 @@
+#include "pngstreamwriter.h"
+
+PngStreamWriter::PngStreamWriter() {}
+
+PngStreamWriter::~PngStreamWriter() {
+    EndStream();
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::Open creates the file and writes the header
+ * @param fileName
+ * @param widthIn
+ * @param heightIn
+ * @return 0 for pass
+ */
+int PngStreamWriter::Open(const QString &fileName, qint32 widthIn, qint32 heightIn) {
+    if (widthIn <= 0 || heightIn <= 0) {
+        qWarning("PngStreamWriter::Open invalid size");
+        return -1;
+    }
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("PngStreamWriter::Open could not open file");
+        return -2;
+    }
+    width = widthIn;
+    height = heightIn;
+    rowsWritten = 0;
+    failed = false;
+    rowBuffer.resize(1 + width * 3);
+    chunk.resize(idatChunkLen);
+
+    EndStream();
+    stream = z_stream();
+    if (deflateInit(&stream, compressionLevel) != Z_OK) {
+        qWarning("PngStreamWriter::Open could not start zlib");
+        file.close();
+        return -3;
+    }
+    streamOpen = true;
+    stream.next_out = reinterpret_cast<Bytef*>(chunk.data());
+    stream.avail_out = (uInt)chunk.size();
+
+    static const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+    file.write(signature, sizeof(signature));
+
+    QByteArray ihdr;
+    AppendBigEndian(ihdr, width);
+    AppendBigEndian(ihdr, height);
+    ihdr.append((char)8); // Bit depth
+    ihdr.append((char)2); // Colour type: RGB
+    ihdr.append((char)0); // Compression method: deflate
+    ihdr.append((char)0); // Filter method: adaptive
+    ihdr.append((char)0); // Interlace: none
+    WriteChunk("IHDR", ihdr);
+    return failed ? -4 : 0;
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::WriteRow writes the next row of the image
+ * @param pixels is one row of width pixels. Alpha is ignored.
+ * @return 0 for pass
+ */
+int PngStreamWriter::WriteRow(const QRgb *pixels) {
+    if (!file.isOpen() || rowsWritten >= height) {
+        return -1;
+    }
+    char* row = rowBuffer.data();
+    row[0] = 0; // Filter type: none
+    for (qint32 x = 0; x < width; x++) {
+        row[1 + 3*x] = (char)qRed(pixels[x]);
+        row[2 + 3*x] = (char)qGreen(pixels[x]);
+        row[3 + 3*x] = (char)qBlue(pixels[x]);
+    }
+    Deflate(rowBuffer, Z_NO_FLUSH);
+    rowsWritten++;
+    return failed ? -2 : 0;
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::Close finishes the image data and closes the file
+ * @return 0 for pass
+ */
+int PngStreamWriter::Close() {
+    if (!file.isOpen()) {
+        return -1;
+    }
+    if (rowsWritten != height) {
+        qWarning("PngStreamWriter::Close %d of %d rows were written", rowsWritten, height);
+        failed = true;
+    }
+    if (streamOpen) {
+        Deflate(QByteArray(), Z_FINISH);
+        FlushChunk();
+        EndStream();
+    }
+    WriteChunk("IEND", QByteArray());
+    file.close();
+    return failed ? -2 : 0;
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::Deflate compresses data into the chunk buffer. Each
+ * time the buffer fills, it's written as an IDAT chunk.
+ * @param data is uncompressed image data
+ * @param flush is Z_NO_FLUSH, or Z_FINISH to end the stream
+ */
+void PngStreamWriter::Deflate(const QByteArray &data, int flush) {
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = (uInt)data.size();
+    while (true) {
+        int ret = deflate(&stream, flush);
+        if (ret == Z_STREAM_ERROR) {
+            qWarning("PngStreamWriter::Deflate zlib error");
+            failed = true;
+            return;
+        }
+        if (stream.avail_out == 0) {
+            FlushChunk();
+        }
+        else if (flush == Z_FINISH ? ret == Z_STREAM_END : stream.avail_in == 0) {
+            return;
+        }
+    }
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::FlushChunk writes the compressed data in the chunk
+ * buffer as an IDAT chunk, and empties the buffer
+ */
+void PngStreamWriter::FlushChunk() {
+    qint32 len = chunk.size() - (qint32)stream.avail_out;
+    if (len > 0) {
+        WriteChunk("IDAT", QByteArray::fromRawData(chunk.constData(), len));
+    }
+    stream.next_out = reinterpret_cast<Bytef*>(chunk.data());
+    stream.avail_out = (uInt)chunk.size();
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::EndStream frees the zlib state
+ */
+void PngStreamWriter::EndStream() {
+    if (streamOpen) {
+        deflateEnd(&stream);
+        streamOpen = false;
+    }
+}
+
+/** ****************************************************************************
+ * @brief PngStreamWriter::WriteChunk writes length, type, data & CRC
+ * @param type is 4 characters
+ * @param data
+ */
+void PngStreamWriter::WriteChunk(const char *type, const QByteArray &data) {
+    QByteArray head;
+    AppendBigEndian(head, data.size());
+    head.append(type, 4);
+    uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data.constData()), (uInt)data.size());
+    QByteArray tail;
+    AppendBigEndian(tail, (quint32)crc);
+    if (file.write(head) != head.size() || file.write(data) != data.size()
+            || file.write(tail) != tail.size()) {
+        failed = true;
+    }
+}
+
+void PngStreamWriter::AppendBigEndian(QByteArray &arr, quint32 val) {
+    arr.append((char)(val >> 24));
+    arr.append((char)(val >> 16));
+    arr.append((char)(val >> 8));
+    arr.append((char)val);
+}
@@ -0,0 +1,48 @@
+#ifndef PNGSTREAMWRITER_H
+#define PNGSTREAMWRITER_H
+
+#include <QtGlobal>
+#include <QFile>
+#include <QByteArray>
+#include <QRgb>
+#include <zlib.h>
+
+/** ****************************************************************************
+ * @brief The PngStreamWriter class writes a PNG file one row at a time, so
+ * that images far larger than memory can be saved.
+ * Rows are written as 8 bit RGB with no filtering, and streamed through zlib.
+ * Each time the output buffer fills, it's written as an IDAT chunk, so no more
+ * than one chunk of image data (plus the zlib state) is ever held in memory.
+ * Usage: Open(), WriteRow() exactly height times, then Close().
+ */
+class PngStreamWriter {
+public:
+    static constexpr qint32 idatChunkLen = 65536; // Length of the compressed data in each IDAT chunk
+    static constexpr int compressionLevel = 3; // zlib level. Low, as streamed images are huge
+
+    PngStreamWriter();
+    ~PngStreamWriter();
+
+    int Open(const QString& fileName, qint32 width, qint32 height);
+    int WriteRow(const QRgb* pixels);
+    int Close();
+
+private:
+    QFile file;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint32 rowsWritten = 0;
+    z_stream stream; // The zlib stream of the image data
+    bool streamOpen = false; // True between deflateInit and deflateEnd
+    QByteArray chunk; // Compressed data waiting to be written as an IDAT chunk
+    QByteArray rowBuffer;
+    bool failed = false;
+
+    void Deflate(const QByteArray& data, int flush);
+    void FlushChunk();
+    void EndStream();
+    void WriteChunk(const char* type, const QByteArray& data);
+    static void AppendBigEndian(QByteArray& arr, quint32 val);
+};
+
+#endif // PNGSTREAMWRITER_H
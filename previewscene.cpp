@@ -9,6 +9,8 @@
 #include <QGradient>
 #include <QGuiApplication>
 #include <QScreen>
+#include <QPixmap>
+#include <QPainter>
 
 /** ****************************************************************************
  * @brief PreviewScene::PreviewScene
@@ -192,27 +194,55 @@ void PreviewView::resizeEvent(QResizeEvent *event) {
         this->fitInView(imageGen.areaSim, Qt::KeepAspectRatio);
     }
 
-    // Set the target image points to the new size
-    qint32 imgPixCount = this->size().width() * this->size().height();
+    UpdateImageSizes();
+
+    QGraphicsView::resizeEvent(event);
+    // Background redraw will be triggered
+
+    // !@# imageGen.NewImageNeeded();
+    // TODO reduce the gradual scaling that occurs when generating a new image here
+}
 
+
+/** ****************************************************************************
+ * @brief PreviewView::UpdateImageSizes sets the size of the preview and quick
+ * images to suit the current view size
+ */
+void PreviewView::UpdateImageSizes()
+{
     qreal capMult = 1.0;
     if (mainWindow.programMode == ProgramMode::fourBar) {
         capMult = 3.0;
     }
 
-    imageGen.setTargetImgPoints(std::min(imgPixCount, qint32(capMult * GenSettings::dfltImgPointsPreview)), imageGen.genPreview);
+    if (exactPixelSize) {
+        // Render the preview at the exact device pixel size (including HiDPI
+        // scaling), so that it's drawn without resampling. The quick image uses
+        // an integer divisor of that size, so it scales up without filtering.
+        QSize devicePixSize = SceneDevicePixelSize();
+        bool ratioMatches = !devicePixSize.isEmpty() &&
+                std::abs(imageGen.areaSim.width() / imageGen.areaSim.height() /
+                         (qreal)devicePixSize.width() * (qreal)devicePixSize.height() - 1) < 0.01;
+        if (ratioMatches) { // Otherwise, the view transform hasn't caught up with an aspect ratio change yet
+            imageGen.setTargetImgSize(devicePixSize, imageGen.genPreview);
+
+            qint32 quickDivisor = ImageGen::PixelDivisor(devicePixSize, capMult * imageGen.GetQuickImgPoints());
+            imageGen.setTargetImgSize(QSize(devicePixSize.width() / quickDivisor,
+                                            devicePixSize.height() / quickDivisor), imageGen.genQuick);
+            return;
+        }
+    }
 
-    // Set the quick image size that the quick preview size is less
-    imageGen.setTargetImgPoints(std::min(imgPixCount, qint32(capMult * GenSettings::dfltImgPointsQuick)), imageGen.genQuick);
+    // Set the target image points to the new size
+    qint32 imgPixCount = this->size().width() * this->size().height();
 
-    QGraphicsView::resizeEvent(event);
-    // Background redraw will be triggered
+    imageGen.setTargetImgPoints(std::min(imgPixCount, qint32(capMult * GenSettings::dfltImgPointsPreview)), imageGen.genPreview);
 
-    // !@# imageGen.NewImageNeeded();
-    // TODO reduce the gradual scaling that occurs when generating a new image here
+    // Set the quick image size that the quick preview size is less
+    // (the quick image size is adapted by ImageGen to keep drags within the frame budget)
+    imageGen.setTargetImgPoints(std::min(imgPixCount, qint32(capMult * imageGen.GetQuickImgPoints())), imageGen.genQuick);
 }
 
-
 /** ****************************************************************************
  * @brief PreviewView::sizeHint
  * @return
@@ -224,18 +254,54 @@ QSize PreviewView::sizeHint() const
 
 
 /** ****************************************************************************
- * @brief PreviewView::OnPatternImageChange
+ * @brief PreviewView::OnNewFrame is called when a new frame has been published.
+ * The frame is taken from the queue on the next paint, so frames that are
+ * replaced before then are never displayed.
  */
-void PreviewView::OnPatternImageChange(QImage & image, qreal imgPerSimUnit, QColor backgroundClr)
+void PreviewView::OnNewFrame()
 {
     scene()->invalidate(imageGen.areaSim, QGraphicsScene::BackgroundLayer);
     // resetCachedContent(); // Delete previously cached background to force redraw
-    patternImage = &image;
-    patternImgPerSimUnit = imgPerSimUnit;
-    backgroundColour = backgroundClr;
     update(); // Redraws, but not immediately
 }
 
+/** ****************************************************************************
+ * @brief PreviewView::SceneDevicePixelSize
+ * @return the size of the scene rectangle on screen, in physical (device) pixels
+ */
+QSize PreviewView::SceneDevicePixelSize() const
+{
+    QSizeF viewSize = transform().mapRect(sceneRect()).size() * devicePixelRatioF();
+    return QSize(qRound(viewSize.width()), qRound(viewSize.height()));
+}
+
+/** ****************************************************************************
+ * @brief PreviewView::UpdatePatternPixmap scales the pattern image to the
+ * given size and blends it over the background colour. This is done once per
+ * new image (or view resize), so that repaints are a simple blit.
+ * @param devicePixSize is the size of the pixmap, in device pixels
+ */
+void PreviewView::UpdatePatternPixmap(QSize devicePixSize)
+{
+    patternPixmap = QPixmap(devicePixSize);
+    patternPixmap.fill(backgroundColour);
+    QPainter pixPainter(&patternPixmap);
+    qint32 scaleFactor = qRound((qreal)devicePixSize.width() / patternImage->width());
+    if (patternImage->size() == devicePixSize) {
+        pixPainter.drawImage(0, 0, *patternImage);
+    }
+    else if (scaleFactor > 1 &&
+             std::abs(patternImage->width() * scaleFactor - devicePixSize.width()) < scaleFactor &&
+             std::abs(patternImage->height() * scaleFactor - devicePixSize.height()) < scaleFactor) {
+        // Integer multiple (a quick image in pixel-exact mode). Pixel replication, no filtering
+        pixPainter.drawImage(0, 0, patternImage->scaled(devicePixSize, Qt::IgnoreAspectRatio, Qt::FastTransformation));
+    }
+    else {
+        pixPainter.drawImage(0, 0, patternImage->scaled(devicePixSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    }
+    patternPixmapValid = true;
+}
+
 /** ****************************************************************************
  * @brief PreviewView::drawBackground
  * @param painter
@@ -248,26 +314,36 @@ void PreviewView::drawBackground(QPainter *painter, const QRectF &rect)
     // This function is called to draw partial backgrounds and complete backgrounds.
     // 'rect' indicates the background section to draw (in scene units)
 
-    // Image coordinates map to the scene / simulation coordinates with
-    // a factor of imgPerSimUnit. The image itself has dimensions that start at 0,0,
-    // whilst the scene can start at any point.
-
-    painter->fillRect(sceneRect(), backgroundColour);
-    if (0) { // Draw only the requested portion of the background
-        // This is somewhat unreliable (Dean R 2021-02-17)
-        QRectF imgSourceRect((rect.topLeft() - sceneRect().topLeft()) * patternImgPerSimUnit,
-                             rect.size() * patternImgPerSimUnit);
-        painter->drawImage(rect, *patternImage, imgSourceRect);
-        //        qDebug("drawBackground. rect=(%.2fx%.2f). @(%.2f, %.2f). imgSrcRect=(%.2fx%.2f). viewSz=(%dx%d)",
-        //               rect.width(), rect.height(), rect.x(), rect.y(), imgSourceRect.width(), imgSourceRect.height(),
-        //               this->width(), this->height());
-    }else { // Redraw the entire background (seems more resiliant with various types of resizing)
-        painter->drawImage(sceneRect(), *patternImage, patternImage->rect());
-//                qDebug("drawBackground. rect=(%.2fx%.2f). @(%.2f, %.2f). viewSz=(%dx%d), sceneRect=(%.1fx%.1f)",
-//                       rect.width(), rect.height(), rect.x(), rect.y(),
-//                       this->width(), this->height(),
-//                       sceneRect().width(), sceneRect().height());
+    // The pattern image is scaled to the view's device resolution once (see
+    // UpdatePatternPixmap). Each repaint then only copies the dirty section of
+    // that pixmap, so moving overlay items and expose events are cheap.
+    if (imageGen.frameQueue.HasNewFrame()) {
+        const Frame* frame = imageGen.frameQueue.AcquireFront();
+        patternImage = &frame->image;
+        patternImgPerSimUnit = frame->imgPerSimUnit;
+        backgroundColour = frame->backgroundClr;
+        patternPixmapValid = false; // Rescale once
     }
+    if (!patternImage || patternImage->isNull()) {
+        painter->fillRect(rect & sceneRect(), backgroundColour);
+        return;
+    }
+    QSize devicePixSize = SceneDevicePixelSize();
+    if (devicePixSize.isEmpty()) {
+        return;
+    }
+    if (!patternPixmapValid || patternPixmap.size() != devicePixSize) {
+        UpdatePatternPixmap(devicePixSize);
+    }
+
+    QRectF drawRect = rect & sceneRect();
+    qreal pixPerSimUnit = (qreal)patternPixmap.width() / sceneRect().width();
+    QRectF pixSourceRect((drawRect.topLeft() - sceneRect().topLeft()) * pixPerSimUnit,
+                         drawRect.size() * pixPerSimUnit);
+    painter->drawPixmap(drawRect, patternPixmap, pixSourceRect);
+    //        qDebug("drawBackground. rect=(%.2fx%.2f). @(%.2f, %.2f). pixSrcRect=(%.2fx%.2f). viewSz=(%dx%d)",
+    //               rect.width(), rect.height(), rect.x(), rect.y(), pixSourceRect.width(), pixSourceRect.height(),
+    //               this->width(), this->height());
 }
 
 
@@ -4,6 +4,7 @@
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QGraphicsItemGroup>
+#include <QPixmap>
 #include "imagegen.h"
 #include "interact.h"
 
@@ -51,23 +52,32 @@ public:
     explicit PreviewView(QWidget *parent, MainWindow& mainWindowIn);
     QSize sizeHint() const override;
     void OnAspectRatioChange();
+    void UpdateImageSizes();
+
+    bool exactPixelSize = true; // If true, render previews at the view's exact device pixel size. If false, use target point counts
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
 
 public slots:
-    void OnPatternImageChange(QImage &image, qreal imgPerSimUnit, QColor backgroundClr);
+    void OnNewFrame();
 
     // QGraphicsView interface
 protected:
     void drawBackground(QPainter *painter, const QRectF &rect);
 
+private:
+    QSize SceneDevicePixelSize() const;
+    void UpdatePatternPixmap(QSize devicePixSize);
+
 protected:
     MainWindow& mainWindow;
     bool widthFromHeight; // True if the width is determined by the height. False for the opposite.
-    QImage * patternImage = nullptr;
+    const QImage * patternImage = nullptr; // The front frame of imageGen.frameQueue
     qreal patternImgPerSimUnit; // Saved for the pattern image
     QColor backgroundColour = Qt::black;
+    QPixmap patternPixmap; // patternImage scaled to device pixels, with the background colour pre-blended
+    bool patternPixmapValid = false; // False when patternPixmap must be rebuilt from patternImage
 
     QSize desiredSize;
 };
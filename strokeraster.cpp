@@ -0,0 +1,113 @@
+#include "strokeraster.h"
+#include <cmath>
+
+/** ****************************************************************************
+ * @brief RasterTarget::FromImage
+ * @param img must be a 32 bit format (RGB32, ARGB32 or ARGB32_Premultiplied)
+ * @return
+ */
+RasterTarget RasterTarget::FromImage(QImage &img) {
+    RasterTarget target;
+    if (img.depth() != 32) {
+        qWarning("RasterTarget::FromImage requires a 32 bit image");
+        return target;
+    }
+    target.pixels = reinterpret_cast<QRgb*>(img.bits());
+    target.stride = img.bytesPerLine() / sizeof(QRgb);
+    target.area = img.rect();
+    return target;
+}
+
+/** ****************************************************************************
+ * @brief RasterTarget::FromTile makes a target for one tile of a larger image,
+ * so that it can be drawn to with the larger image's coordinates
+ * @param tile must be a 32 bit format
+ * @param topLeft is the location of the tile in the larger image
+ * @return
+ */
+RasterTarget RasterTarget::FromTile(QImage &tile, QPoint topLeft) {
+    RasterTarget target = FromImage(tile);
+    if (target.pixels != nullptr) {
+        target.pixels -= (qintptr)topLeft.y() * target.stride + topLeft.x();
+        target.area.translate(topLeft);
+    }
+    return target;
+}
+
+/** ****************************************************************************
+ * @brief StrokeRaster::DrawSegment draws one round capped line segment
+ * Coverage falls from 1 to 0 over the 1 pixel band centred on the capsule edge.
+ * Segments thinner than 1 pixel are drawn with reduced coverage, so that the
+ * total coverage across the line matches its width.
+ * @param target
+ * @param x0 start point, in pixel coordinates (pixel (x,y) covers x to x+1)
+ * @param y0
+ * @param x1 end point
+ * @param y1
+ * @param width of the line, in pixels
+ * @param clr is drawn with its alpha ignored
+ */
+void StrokeRaster::DrawSegment(const RasterTarget &target, qreal x0, qreal y0,
+                               qreal x1, qreal y1, qreal width, QRgb clr) {
+    if (target.pixels == nullptr || !(width > 0)) {
+        return;
+    }
+    const qreal radius = width / 2;
+    const qreal reach = radius + 0.5; // Beyond this distance, coverage is 0
+    const qreal thinGain = width < 1. ? width / (reach * reach) : 1.;
+
+    // Clipped bounding box of the capsule
+    qint32 yStart = qMax(target.area.top(), (qint32)floor(qMin(y0, y1) - reach));
+    qint32 yEnd = qMin(target.area.bottom(), (qint32)ceil(qMax(y0, y1) + reach));
+    if (yStart > yEnd) {
+        return;
+    }
+
+    const qreal dx = x1 - x0;
+    const qreal dy = y1 - y0;
+    const qreal lenSq = dx*dx + dy*dy;
+    const qreal invLenSq = lenSq > 1e-12 ? 1. / lenSq : 0.;
+    const qint32 clrR = qRed(clr), clrG = qGreen(clr), clrB = qBlue(clr);
+
+    for (qint32 y = yStart; y <= yEnd; y++) {
+        const qreal py = y + 0.5;
+        // Any covered pixel is within 'reach' (in x) of a segment point that is within 'reach' (in y) of this row
+        qreal tA = 0., tB = 1.;
+        if (dy != 0.) {
+            tA = (py - reach - y0) / dy;
+            tB = (py + reach - y0) / dy;
+            if (tA > tB) {
+                qSwap(tA, tB);
+            }
+            tA = qMax(tA, 0.);
+            tB = qMin(tB, 1.);
+        }
+        const qreal xA = x0 + dx * tA;
+        const qreal xB = x0 + dx * tB;
+        qint32 xStart = qMax(target.area.left(), (qint32)floor(qMin(xA, xB) - reach));
+        qint32 xEnd = qMin(target.area.right(), (qint32)ceil(qMax(xA, xB) + reach));
+
+        QRgb* row = target.pixels + (qintptr)y * target.stride;
+        for (qint32 x = xStart; x <= xEnd; x++) {
+            // Distance from the pixel centre to the segment
+            const qreal px = x + 0.5 - x0;
+            const qreal pyRel = py - y0;
+            const qreal t = qBound(0., (px*dx + pyRel*dy) * invLenSq, 1.);
+            const qreal ex = px - t*dx;
+            const qreal ey = pyRel - t*dy;
+            const qreal dist = sqrt(ex*ex + ey*ey);
+            const qreal coverage = qBound(0., reach - dist, 1.) * thinGain;
+            if (coverage <= 0.) {
+                continue;
+            }
+            // Source-over blend. Coverage is 0 to 256
+            const qint32 a = (qint32)(coverage * 256.);
+            const QRgb dst = row[x];
+            const qint32 r = qRed(dst) + (((clrR - qRed(dst)) * a) >> 8);
+            const qint32 g = qGreen(dst) + (((clrG - qGreen(dst)) * a) >> 8);
+            const qint32 b = qBlue(dst) + (((clrB - qBlue(dst)) * a) >> 8);
+            const qint32 alpha = qAlpha(dst) + (((255 - qAlpha(dst)) * a) >> 8);
+            row[x] = qRgba(r, g, b, alpha);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef STROKERASTER_H
+#define STROKERASTER_H
+
+#include <QtGlobal>
+#include <QRgb>
+#include <QRect>
+#include <QImage>
+
+/** ****************************************************************************
+ * @brief The RasterTarget struct is a direct view of 32 bit image pixels
+ */
+struct RasterTarget {
+    QRgb* pixels = nullptr; // Pixel (0,0). It may not be a valid address
+    qint32 stride = 0; // Pixels per row
+    QRect area; // Pixels that may be drawn to (clip rectangle)
+    static RasterTarget FromImage(QImage& img);
+    static RasterTarget FromTile(QImage& tile, QPoint topLeft);
+};
+
+/** ****************************************************************************
+ * @brief The StrokeRaster class draws anti-aliased, round capped line segments
+ * directly into a RasterTarget.
+ * Each segment is a capsule (the set of points within width/2 of the line).
+ * Pixel coverage is calculated from the distance between the pixel centre and
+ * the segment, and the colour is blended with source-over.
+ * This avoids all QPainter state changes, so it is much faster for polylines
+ * where every segment has a different width.
+ */
+class StrokeRaster {
+public:
+    static void DrawSegment(const RasterTarget& target, qreal x0, qreal y0,
+                            qreal x1, qreal y1, qreal width, QRgb clr);
+};
+
+#endif // STROKERASTER_H
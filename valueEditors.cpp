@@ -77,7 +77,7 @@ void SliderSpinEditor::SpinChangedSlot()
     slider.blockSignals(true);
     slider.setValue(GetExtVal() * sliderScaler);
     slider.blockSignals(false);
-    parentGroupWidget->InternalValueEdited();
+    parentGroupWidget->InternalValueEdited(ExtValPtr());
 }
 
 /** ****************************************************************************
@@ -91,10 +91,10 @@ void SliderSpinEditor::SliderChangedSlot()
     spinBox.blockSignals(false);
     if (slider.isSliderDown()) {
         // User is currently dragging the slider
-        parentGroupWidget->InternalValueEditedQuick();
+        parentGroupWidget->InternalValueEditedQuick(ExtValPtr());
     }
     else {
-        parentGroupWidget->InternalValueEdited();
+        parentGroupWidget->InternalValueEdited(ExtValPtr());
     }
 }
 
@@ -165,16 +165,19 @@ void ValueEditorGroupWidget::ApplyExternalValues()
 
 /** ****************************************************************************
  * @brief EditorGroupWidget::InternalValueEdited
+ * @param field is the address of the edited value
  */
-void ValueEditorGroupWidget::InternalValueEdited()
+void ValueEditorGroupWidget::InternalValueEdited(const void* field)
 {
     prevEditSignalWasQuick = false;
+    emit FieldEditedSig(field);
     emit ValueEditedSig();
 }
 
-void ValueEditorGroupWidget::InternalValueEditedQuick()
+void ValueEditorGroupWidget::InternalValueEditedQuick(const void* field)
 {
     prevEditSignalWasQuick = true;
+    emit FieldEditedSig(field);
     emit ValueEditedQuickSig();
 }
 
@@ -42,6 +42,7 @@ private:
 private:
     void ConstructorSub(const QString &name);
     qreal GetExtVal() {return extValue == nullptr ? (qreal)*extValueInt : *extValue;}
+    const void* ExtValPtr() const {return extValue == nullptr ? (const void*)extValueInt : (const void*)extValue;}
     void SetExtVal(qreal setTo) {if (extValue == nullptr) *extValueInt = qRound(setTo);
     else *extValue = setTo;}
 
@@ -69,10 +70,11 @@ public:
     void ApplyExternalValues();
 
 private:
-    void InternalValueEdited(); // Called by this widget's editors when the value is edited
-    void InternalValueEditedQuick(); // Called by this widget's editors when the value is edited during a drag
+    void InternalValueEdited(const void* field); // Called by this widget's editors when the value is edited
+    void InternalValueEditedQuick(const void* field); // Called by this widget's editors when the value is edited during a drag
 
 signals:
+    void FieldEditedSig(const void* field); // Emitted before ValueEditedSig or ValueEditedQuickSig, with the address of the edited value
     void ValueEditedSig();
     void ValueEditedQuickSig();
 